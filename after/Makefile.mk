@@ -1,31 +1,60 @@
 include mk.config
 
-OBJS := $(OBJDIR)/alloc.o $(OBJDIR)/grep.o $(OBJDIR)/grid.o
+OBJS := $(OBJDIR)/alloc.o $(OBJDIR)/grep.o $(OBJDIR)/grid.o $(OBJDIR)/trigram.o $(OBJDIR)/follow.o $(OBJDIR)/context.o $(OBJDIR)/names.o $(OBJDIR)/ignore.o
 
 LIB_GREP := $(OBJDIR)/libgrep.a
 LIB_COMMON := libcommon/libcommon.a
 LIB_UXRE := libuxre/libuxre.a
 
-all: egrep fgrep grep grep_sus grep_su3
+all: egrep fgrep grep grep_sus grep_su3 grepd grepc grepidx
 
 egrep: $(OBJS) $(LIB_GREP) $(LIB_COMMON) $(LIB_UXRE) $(OBJDIR)/egrep_main.o $(OBJDIR)/plist.o $(OBJDIR)/svid3.o
 	$(LD) $(LDFLAGS) $^ $(LCOMMON) $(LWCHAR) $(LIBS) -o $@
 
-fgrep: $(OBJS) $(LIB_GREP) $(LIB_COMMON) $(LIB_UXRE)  $(OBJDIR)/fgrep_main.o $(OBJDIR)/plist.o $(OBJDIR)/ac.o $(OBJDIR)/svid3.o
+fgrep: $(OBJS) $(LIB_GREP) $(LIB_COMMON) $(LIB_UXRE)  $(OBJDIR)/fgrep_main.o $(OBJDIR)/plist.o $(OBJDIR)/acgrep.o $(OBJDIR)/ac.o $(OBJDIR)/svid3.o
 	$(LD) $(LDFLAGS) $^ $(LCOMMON) $(LWCHAR) $(LIBS) -o $@
 
 grep: $(OBJS)  $(LIB_GREP) $(LIB_COMMON) $(LIB_UXRE) $(OBJDIR)/grep_main.o $(OBJDIR)/svid3.o
 	$(LD) $(LDFLAGS) $^ $(LCOMMON) $(LWCHAR) $(LIBS) -o $@
 
-grep_sus: $(OBJS) $(LIB_GREP)  $(LIB_COMMON) $(LIB_UXRE) $(OBJDIR)/plist.o $(OBJDIR)/rcomp.o $(OBJDIR)/sus.o $(OBJDIR)/ac.o
+grep_sus: $(OBJS) $(LIB_GREP)  $(LIB_COMMON) $(LIB_UXRE) $(OBJDIR)/plist.o $(OBJDIR)/rcomp.o $(OBJDIR)/sus.o $(OBJDIR)/acgrep.o $(OBJDIR)/ac.o
 	$(LD) $(LDFLAGS) $^ $(LUXRE) $(LCOMMON) $(LWCHAR) $(LIBS) -o $@
 
-grep_su3: $(OBJS) $(LIB_GREP) $(LIB_COMMON) $(LIB_UXRE)  $(OBJDIR)/plist.o $(OBJDIR)/rcomp.o $(OBJDIR)/su3.o $(OBJDIR)/ac.o
+grep_su3: $(OBJS) $(LIB_GREP) $(LIB_COMMON) $(LIB_UXRE)  $(OBJDIR)/plist.o $(OBJDIR)/rcomp.o $(OBJDIR)/su3.o $(OBJDIR)/acgrep.o $(OBJDIR)/ac.o
+	$(LD) $(LDFLAGS) $^ $(LUXRE) $(LCOMMON) $(LWCHAR) $(LIBS) -o $@
+
+grepd: $(OBJDIR)/grepd.o $(OBJDIR)/gdmsg.o $(LIB_GREP) $(LIB_UXRE)
+	$(LD) $(LDFLAGS) $^ $(LWCHAR) $(LIBS) -lpthread -o $@
+
+grepc: $(OBJDIR)/grepc.o $(OBJDIR)/gdmsg.o $(OBJDIR)/alloc.o
+	$(LD) $(LDFLAGS) $^ $(LIBS) -o $@
+
+grepidx: $(OBJDIR)/grepidx.o $(OBJDIR)/alloc.o
+	$(LD) $(LDFLAGS) $^ $(LIBS) -o $@
+
+RB_OBJS := $(OBJS) $(LIB_GREP) $(LIB_COMMON) $(LIB_UXRE) $(OBJDIR)/rangebench.o
+
+.PHONY: rangebench
+rangebench: rangebench_grep rangebench_egrep rangebench_fgrep rangebench_sus
+
+rangebench_grep: $(RB_OBJS) $(OBJDIR)/rb_grep_main.o $(OBJDIR)/svid3.o
+	$(LD) $(LDFLAGS) $^ $(LCOMMON) $(LWCHAR) $(LIBS) -o $@
+
+rangebench_egrep: $(RB_OBJS) $(OBJDIR)/rb_egrep_main.o $(OBJDIR)/plist.o $(OBJDIR)/svid3.o
+	$(LD) $(LDFLAGS) $^ $(LCOMMON) $(LWCHAR) $(LIBS) -o $@
+
+rangebench_fgrep: $(RB_OBJS) $(OBJDIR)/rb_fgrep_main.o $(OBJDIR)/plist.o $(OBJDIR)/acgrep.o $(OBJDIR)/ac.o $(OBJDIR)/svid3.o
+	$(LD) $(LDFLAGS) $^ $(LCOMMON) $(LWCHAR) $(LIBS) -o $@
+
+rangebench_sus: $(RB_OBJS) $(OBJDIR)/rb_sus.o $(OBJDIR)/plist.o $(OBJDIR)/rcomp.o $(OBJDIR)/acgrep.o $(OBJDIR)/ac.o
 	$(LD) $(LDFLAGS) $^ $(LUXRE) $(LCOMMON) $(LWCHAR) $(LIBS) -o $@
 
 $(OBJDIR)/%.o: %.c | $(OBJDIR)
 	$(CC) $(CFLAGSS) $(CPPFLAGS) $(IWCHAR) $(ICOMMON) $(IUXRE) $(LARGEF) -c $< -o $@
 
+$(OBJDIR)/rb_%.o: %.c | $(OBJDIR)
+	$(CC) $(CFLAGSS) $(CPPFLAGS) $(IWCHAR) $(ICOMMON) $(IUXRE) $(LARGEF) -DRANGEBENCH -c $< -o $@
+
 $(OBJDIR)/sus.o: sus.c | $(OBJDIR)
 	$(CC) $(CFLAGSS) $(CPPFLAGS) $(IWCHAR) $(ICOMMON) $(IUXRE) $(LARGEF) -DSUS -c $< -o $@
 
@@ -39,8 +68,8 @@ egrep_main.c: egrep.y
 $(OBJDIR):
 	@mkdir -p $@
 
-$(LIB_GREP): $(OBJDIR)/grep.o
-	$(AR) -rv $@ $<
+$(LIB_GREP): $(OBJDIR)/libgrep.o $(OBJDIR)/patset.o $(OBJDIR)/ac.o $(OBJDIR)/alloc.o
+	$(AR) -rv $@ $^
 	$(RANLIB) $@
 
 $(LIB_COMMON):
@@ -49,9 +78,13 @@ $(LIB_COMMON):
 $(LIB_UXRE):
 	cd libuxre && $(MAKE) -f Makefile.mk
 
-test: grep
+test: grep grep_sus grepd grepc grepidx
 	@echo "Running smoke tests.."
-	cd .. && G=./after/grep SYS_GREP=/bin/grep bash smoke-test.sh
+	cd .. && G=./after/grep GS=./after/grep_sus SYS_GREP=/bin/grep bash smoke-test.sh
+
+bench: all
+	@echo "Running benchmarks.."
+	cd .. && bash bench.sh --bindir ./after $(BENCHFLAGS)
 
 install: all
 	$(UCBINST) -c egrep $(ROOT)$(SV3BIN)/egrep
@@ -70,14 +103,23 @@ install: all
 	rm -f $(ROOT)$(SU3BIN)/egrep $(ROOT)$(SU3BIN)/fgrep
 	$(LNS) grep $(ROOT)$(SU3BIN)/egrep
 	$(LNS) grep $(ROOT)$(SU3BIN)/fgrep
+	$(UCBINST) -c grepd $(ROOT)$(SUSBIN)/grepd
+	$(STRIP) $(ROOT)$(SUSBIN)/grepd
+	$(UCBINST) -c grepc $(ROOT)$(SUSBIN)/grepc
+	$(STRIP) $(ROOT)$(SUSBIN)/grepc
+	$(UCBINST) -c grepidx $(ROOT)$(SUSBIN)/grepidx
+	$(STRIP) $(ROOT)$(SUSBIN)/grepidx
 	$(MANINST) -c -m 644 egrep.1 $(ROOT)$(MANDIR)/man1/egrep.1
 	$(MANINST) -c -m 644 fgrep.1 $(ROOT)$(MANDIR)/man1/fgrep.1
 	$(MANINST) -c -m 644 grep.1 $(ROOT)$(MANDIR)/man1/grep.1
+	$(MANINST) -c -m 644 grepd.1 $(ROOT)$(MANDIR)/man1/grepd.1
+	$(MANINST) -c -m 644 grepidx.1 $(ROOT)$(MANDIR)/man1/grepidx.1
 
 clean:
 	cd libcommon && $(MAKE) -f Makefile.mk clean
 	cd libuxre && $(MAKE) -f Makefile.mk clean
-	rm -rf $(OBJDIR) egrep fgrep grep grep_sus grep_su3 egrep.c
+	rm -rf $(OBJDIR) egrep fgrep grep grep_sus grep_su3 grepd grepc grepidx egrep.c \
+		rangebench_grep rangebench_egrep rangebench_fgrep rangebench_sus
 
 config.h:
 	-echo '/*	Auto-generated by make. Do not edit!	*/' >config.h
@@ -106,4 +148,17 @@ $(OBJDIR)/svid3.o: public.h config.h
 $(OBJDIR)/sus.o: public.h config.h alloc.h
 $(OBJDIR)/su3.o: public.h config.h alloc.h
 $(OBJDIR)/ac.o: alloc.h grep.h
+$(OBJDIR)/acgrep.o: public.h alloc.h grep.h
+$(OBJDIR)/libgrep.o: public.h alloc.h grep.h
+$(OBJDIR)/patset.o: public.h grep.h
+$(OBJDIR)/grepd.o: public.h alloc.h grepd.h
+$(OBJDIR)/grepc.o: public.h alloc.h grepd.h
+$(OBJDIR)/gdmsg.o: alloc.h grepd.h
+$(OBJDIR)/trigram.o: alloc.h grep.h trigram.h
+$(OBJDIR)/follow.o: alloc.h grep.h public.h
+$(OBJDIR)/context.o: alloc.h grep.h
+$(OBJDIR)/names.o: alloc.h grep.h
+$(OBJDIR)/ignore.o: alloc.h grep.h
+$(OBJDIR)/grepidx.o: alloc.h trigram.h
+$(OBJDIR)/rangebench.o: public.h alloc.h grep.h
 $(OBJDIR)/rcomp.o: public.h config.h alloc.h
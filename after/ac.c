@@ -47,526 +47,835 @@
 #endif
 static const char sccsid[] USED = "@(#)fgrep.sl	2.10 (gritter) 5/29/05";
 
+/*
+ * The automaton itself. Nothing in here refers to the options or to
+ * other global state of grep; everything is passed in, so automata
+ * can be built and searched by several threads at once. The command
+ * side is in acgrep.c.
+ */
+
 #include "alloc.h"
 #include "grep.h"
-#include "public.h"
+#include <ctype.h>
+#include <fcntl.h>
 #include <limits.h>
+#include <locale.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/types.h>
+#include <unistd.h>
+#include <wchar.h>
+#include <wctype.h>
 
 #include <mbtowi.h>
 
 #define MAXSIZ 256
-#define QSIZE 128
 
+/*
+ * The trie is built from words, one for each transition of a state,
+ * linked on a chain; the first word of a chain stands for the state.
+ */
 struct words {
 	struct words *nst;
 	struct words *link;
 	struct words *fail;
 	int inp;
+	int olen; /* length in bytes of a pattern ending here, or 0 */
+	int num;  /* state number, see ac_pack() */
 	char out;
 };
 
-static struct words *w, *wcur;
-static struct words *smax;
-static struct words *q;
-
-static void ac_build(void);
-static int ac_match(const char *, size_t);
-static int ac_matchw(const char *, size_t);
-static int ac_range(struct iblok *, char *);
-static int ac_rangew(struct iblok *, char *);
-static void cgotofn(void);
-static void check(int, int);
-static void woverflo(void);
-static void qoverflo(struct words ***queue, int *qsize);
-static void cfail(void);
-static int a0_match(const char *, size_t);
-static int a1_match(const char *, size_t);
-
-void ac_select(void)
+/*
+ * While the automaton is built, each word on the link chain of a state
+ * but the first is also entered into a hash table keyed by the state
+ * and its input character. Chains near the root are as long as the
+ * alphabet, and both cgotofn() and cfail() look there all the time.
+ */
+struct hent {
+	struct words *h_s; /* state, i.e. first word of the chain */
+	struct words *h_w; /* word on the chain of h_s */
+};
+
+/*
+ * The breadth first queue of cfail() is overwritten by ac_pack().
+ */
+union acq {
+	struct words *q_w;
+	struct acst q_s;
+};
+
+/*
+ * Everything needed while an automaton is built.
+ */
+struct acbuild {
+	struct words *b_w;	/* root */
+	struct words *b_wcur;	/* current block of words */
+	struct words *b_smax;	/* last word allocated */
+	long b_nword;		/* words allocated */
+	struct arena b_arena;
+	struct hent *b_htab;
+	size_t b_hsize, b_hcount;
+	union acq *b_queue;	/* states in breadth first order */
+	unsigned int b_nstate;
+	struct expr *b_e;	/* pattern read by acnextch() */
+	const char *b_cp;
+	long b_len;
+	int b_eof;
+	int b_flags;
+	int b_err;
+};
+
+static void cgotofn(struct acbuild *);
+static int acnextch(struct acbuild *);
+static void woverflo(struct acbuild *);
+static struct words *acword(struct acbuild *);
+static struct words *acfind(struct acbuild *, struct words *, int);
+static struct words *acgoto(struct acbuild *, struct words *, int);
+static void hput(struct acbuild *, struct words *, struct words *);
+static void cfail(struct acbuild *);
+static struct acaut *ac_pack(struct acbuild *);
+static int aclen(int, int);
+
+/*
+ * Build the automaton for the strings in the expression list e. On
+ * failure, NULL is returned and *err is set to REG_ILLSEQ for an
+ * invalid pattern, or to REG_ESPACE if there are too many states.
+ */
+struct acaut *ac_comp(struct expr *e, int flags, int *err)
 {
-	build = ac_build;
-	match = mbcode ? ac_matchw : ac_match;
-	matchflags &= ~MF_NULTERM;
-	matchflags |= MF_LOCONV;
+	struct acbuild b;
+	struct acaut *a;
+	struct expr *ep;
+
+	memset(&b, 0, sizeof b);
+	b.b_e = e;
+	b.b_flags = flags;
+	if (e->e_flg & E_NULL)
+		b.b_eof = 1;
+	else if ((flags & AC_LINE) == 0)
+		for (ep = e; ep; ep = ep->e_nxt)
+			if (ep->e_len == 0)
+				flags |= AC_ALL;
+	cgotofn(&b);
+	if (b.b_err) {
+		free(b.b_htab);
+		afree(&b.b_arena);
+		*err = b.b_err;
+		return NULL;
+	}
+	cfail(&b);
+	free(b.b_htab);
+	a = ac_pack(&b);
+	a->a_flags = flags;
+	return a;
 }
 
-static void ac_build(void)
+void ac_free(struct acaut *a)
 {
-	struct expr *e;
-
-	if (e0->e_flg & E_NULL) {
-		match = a0_match;
+	if (a == NULL)
 		return;
+	if (a->a_map)
+		munmap(a->a_map, a->a_mapsz);
+	else {
+		free(a->a_st);
+		free(a->a_inp);
+		free(a->a_olen);
+		free(a->a_root);
 	}
-	for (e = e0; e; e = e->e_nxt) {
-		if (e->e_len == 0 && !xflag) {
-			match = a1_match;
-			return;
-		}
-	}
-	cgotofn();
-	cfail();
-	if (!iflag)
-		range = mbcode ? ac_rangew : ac_range;
+	free(a);
 }
 
-static int ac_match(const char *line, size_t sz)
+/*
+ * Enter the patterns into the trie. Unless -x, -w or -o is given, a
+ * line is selected as soon as any pattern is found, so patterns that
+ * begin with another one are never looked at beyond that one: they are
+ * not entered further, and are cut off when the shorter one comes later.
+ */
+static void cgotofn(struct acbuild *b)
 {
-	register const char *p;
-	register int z;
-	register struct words *c;
-	int failed;
+	register int c;
+	register struct words *s, *w;
+	int olen = 0, prune;
 
-	p = line;
-	failed = 0;
-	c = w;
-	if (p == &line[sz])
-		z = '\n';
-	else
-		z = *p & 0377;
+	woverflo(b);
+	s = b->b_smax = w = b->b_w = b->b_wcur;
+	b->b_nword = 1;
+	prune = (b->b_flags & (AC_LINE|AC_WORD|AC_SPAN)) == 0;
 	for (;;) {
-	nstate:
-		if (c->inp == z) {
-			c = c->nst;
-		} else if (c->link != 0) {
-			c = c->link;
-			goto nstate;
-		} else {
-			c = c->fail;
-			failed = 1;
-			if (c == 0) {
-				c = w;
-			istate:
-				if (c->inp == z) {
-					c = c->nst;
-				} else if (c->link != 0) {
-					c = c->link;
-					goto istate;
+		if ((c = acnextch(b)) == EOF && s == w)
+			break;
+		if (b->b_err)
+			return;
+		if (c == '\n' || c == EOF) {
+			if (s) {
+				if (b->b_flags & AC_LINE)
+					s = acgoto(b, s, '\n');
+				else if (prune && s->nst) {
+					s->inp = 0;
+					s->nst = s->link = 0;
 				}
-			} else
-				goto nstate;
-		}
-		if (c->out) {
-			if (xflag) {
-				if (failed || p < &line[sz])
-					return 0;
+				s->out = 1;
+				s->olen = olen;
 			}
-			return 1;
+			olen = 0;
+			s = w;
+			if (c == EOF)
+				break;
+		} else if (s && prune && s->out) {
+			s = NULL;
+		} else if (s) {
+			s = acgoto(b, s, c);
+			olen += aclen(b->b_flags, c);
 		}
-		if (++p >= &line[sz]) {
-			if (z == '\n')
-				return 0;
-			else
-				z = '\n';
-		} else
-			z = *p & 0377;
 	}
 }
 
-static int ac_range(struct iblok *ip, char *last)
+/*
+ * getc() substitute operating on the pattern list, like nextch() in
+ * plist.c.
+ */
+static int acnextch(struct acbuild *b)
 {
-	register char *p;
-	register struct words *c;
-	int failed;
+	struct expr *e;
+	wchar_t wc;
+	int n;
 
-	p = ip->ib_cur;
-	lineno++;
-	failed = 0;
-	c = w;
-	for (;;) {
-	nstate:
-		if (c->inp == (*p & 0377)) {
-			c = c->nst;
-		} else if (c->link != 0) {
-			c = c->link;
-			goto nstate;
+	if (b->b_eof)
+		return EOF;
+	e = b->b_e;
+	if (b->b_cp == NULL) {
+		b->b_cp = e->e_pat;
+		b->b_len = e->e_len;
+	}
+	if (b->b_len > 0 && b->b_flags & AC_MB && *b->b_cp & 0200) {
+		if ((n = mbtowc(&wc, b->b_cp, b->b_len)) < 0) {
+			b->b_err = REG_ILLSEQ;
+			b->b_eof = 1;
+			return EOF;
+		}
+		b->b_cp += n;
+		b->b_len -= n;
+		if (b->b_flags & AC_ICASE)
+			wc = towlower(wc);
+		return wc;
+	} else if (b->b_len > 0) {
+		b->b_len--;
+		n = *b->b_cp++ & 0377;
+		return b->b_flags & AC_ICASE ? tolower(n) : n;
+	}
+	b->b_cp = NULL;
+	n = e->e_flg & E_NL;
+	if ((b->b_e = e->e_nxt) == NULL) {
+		b->b_eof = 1;
+		if (!n)
+			return EOF;
+	}
+	return '\n';
+}
+
+/*
+ * Get a new word.
+ */
+static struct words *acword(struct acbuild *b)
+{
+	if (++b->b_smax >= &b->b_wcur[MAXSIZ])
+		woverflo(b);
+	if (++b->b_nword > (long)~ACOUT) {
+		b->b_err = REG_ESPACE;
+		b->b_nword = 1;
+	}
+	return b->b_smax;
+}
+
+static size_t hslot(struct acbuild *b, struct words *s, int c)
+{
+	size_t h;
+
+	h = (size_t)s / sizeof *s * 31 + (unsigned)c;
+	h ^= h >> 15;
+	h *= 2654435761U;
+	h ^= h >> 13;
+	return h & (b->b_hsize - 1);
+}
+
+/*
+ * Enter word t on the chain of state s into the hash table.
+ */
+static void hput(struct acbuild *b, struct words *s, struct words *t)
+{
+	struct hent *ot, *hp, *htab;
+	size_t i, on;
+
+	if (2 * (b->b_hcount + 1) > b->b_hsize) {
+		ot = b->b_htab;
+		on = b->b_hsize;
+		b->b_hsize = b->b_hsize ? 2 * b->b_hsize : 256;
+		b->b_htab = scalloc(b->b_hsize, sizeof *b->b_htab);
+		b->b_hcount = 0;
+		for (i = 0; i < on; i++)
+			if (ot[i].h_s)
+				hput(b, ot[i].h_s, ot[i].h_w);
+		free(ot);
+	}
+	htab = b->b_htab;
+	for (hp = &htab[hslot(b, s, t->inp)]; hp->h_s;
+			hp = hp < &htab[b->b_hsize - 1] ? &hp[1] : htab)
+		;
+	hp->h_s = s;
+	hp->h_w = t;
+	b->b_hcount++;
+}
+
+/*
+ * Find the word on the chain of state s that has input c.
+ */
+static struct words *acfind(struct acbuild *b, struct words *s, int c)
+{
+	struct hent *hp, *htab = b->b_htab;
+
+	if (s->inp == c && s->nst)
+		return s;
+	if (s->link == 0 || htab == NULL)
+		return NULL;
+	for (hp = &htab[hslot(b, s, c)]; hp->h_s;
+			hp = hp < &htab[b->b_hsize - 1] ? &hp[1] : htab)
+		if (hp->h_s == s && hp->h_w->inp == c)
+			return hp->h_w;
+	return NULL;
+}
+
+/*
+ * Return the state entered from state s on input c, creating it if
+ * necessary. New words are linked right after the first word of the
+ * chain.
+ */
+static struct words *acgoto(struct acbuild *b, struct words *s, int c)
+{
+	struct words *t;
+
+	if ((t = acfind(b, s, c)) == NULL) {
+		if (s->nst) {
+			t = acword(b);
+			t->link = s->link;
+			s->link = t;
+			t->inp = c;
+			hput(b, s, t);
 		} else {
-			c = c->fail;
-			failed = 1;
-			if (c == 0) {
-				c = w;
-			istate:
-				if (c->inp == (*p & 0377)) {
-					c = c->nst;
-				} else if (c->link != 0) {
-					c = c->link;
-					goto istate;
-				}
-			} else
-				goto nstate;
+			t = s;
+			t->inp = c;
 		}
-		if (c->out) {
-			if (xflag) {
-				register char *ep = p;
-				while (*ep != '\n')
-					ep++;
-				if ((failed || ep > p) && vflag == 0) {
-					ip->ib_cur = &ep[1];
-					goto nogood;
-				}
-			}
-			if (vflag == 0) {
-			succeed:
-				outline(ip, last, p - ip->ib_cur);
-				if (qflag || lflag)
-					return 1;
-			} else {
-				ip->ib_cur = p;
-				while (*ip->ib_cur++ != '\n')
-					;
-			}
-		nogood:
-			if ((p = ip->ib_cur) > last)
-				return 0;
-			lineno++;
-			c = w;
-			failed = 0;
-			continue;
+		t->nst = acword(b);
+	}
+	return t->nst;
+}
+
+/*
+ * Length in bytes of a pattern character returned by acnextch().
+ */
+static int aclen(int flags, int c)
+{
+	char mb[MB_LEN_MAX];
+	int n;
+
+	if (flags & AC_MB && c & ~0177 && (n = wctomb(mb, c)) > 0)
+		return n;
+	return 1;
+}
+
+static void woverflo(struct acbuild *b)
+{
+	b->b_wcur = b->b_smax = aalloc(&b->b_arena, MAXSIZ * sizeof *b->b_smax);
+}
+
+static int inpcmp(const void *a, const void *b)
+{
+	int x = (*(struct words *const *)a)->inp;
+	int y = (*(struct words *const *)b)->inp;
+
+	return x < y ? -1 : x > y;
+}
+
+/*
+ * Compute the failure function, breadth first. Every state is queued
+ * once, so the queue needs no more entries than there are words. The
+ * children of a state are queued in order of their input character,
+ * and the order of the queue is kept as state number for ac_pack().
+ * The failure of a state is found by following the failure chain from
+ * its parent until a state with the same transition turns up.
+ */
+static void cfail(struct acbuild *b)
+{
+	unsigned int front, rear, i, n, nkid = 0;
+	struct words **kid = NULL;
+	struct words *f, *t, *w = b->b_w;
+	register struct words *s, *q;
+	union acq *queue;
+
+	queue = b->b_queue = smalloc((b->b_nword + 1) * sizeof *queue);
+	queue[0].q_w = w;
+	w->num = 0;
+	for (front = 0, rear = 1; front < rear; front++) {
+		for (n = 0, s = queue[front].q_w; s; s = s->link) {
+			if (s->nst == 0)
+				continue;
+			if (n >= nkid)
+				kid = srealloc(kid, (nkid = nkid ? 2 * nkid : 256) *
+						sizeof *kid);
+			kid[n++] = s;
 		}
-		if (*p++ == '\n') {
-			if (vflag) {
-				p--;
-				goto succeed;
-			}
-			if ((ip->ib_cur = p) > last)
-				return 0;
-			lineno++;
-			c = w;
-			failed = 0;
+		if (n > 1)
+			qsort(kid, n, sizeof *kid, inpcmp);
+		for (i = 0; i < n; i++) {
+			s = kid[i];
+			q = s->nst;
+			q->num = rear;
+			queue[rear++].q_w = q;
+			if (front == 0)
+				continue;
+			for (f = s->fail; f; f = f->fail)
+				if ((t = acfind(b, f, s->inp)) != NULL)
+					break;
+			if (f == NULL && (t = acfind(b, w, s->inp)) == NULL)
+				continue;
+			do {
+				q->fail = t->nst;
+				if (t->nst->out == 1)
+					q->out = 1;
+			} while ((q = q->link) != 0);
 		}
 	}
+	b->b_nstate = rear;
+	free(kid);
 }
 
-static int ac_matchw(const char *line, size_t sz)
+/*
+ * Lay the states out in the arrays the matchers work on, in the order
+ * of the queue left by cfail(); the words are not needed afterwards.
+ * Each state takes the place of its entry in the queue.
+ */
+static struct acaut *ac_pack(struct acbuild *b)
 {
-	register const char *p;
-	wint_t z;
-	register struct words *c;
-	int failed, n = 0;
+	struct acaut *a;
+	struct words *s, *q;
+	union acq *queue = b->b_queue;
+	unsigned int i, kid, nstate = b->b_nstate;
 
-	p = line;
-	failed = 0;
-	c = w;
-	if (p == &line[sz])
-		z = '\n';
-	else {
-		if (*p & 0200) {
-			if ((n = mbtowi(&z, p, &line[sz] - p)) < 0) {
-				n = 1;
-				z = WEOF;
-			}
-		} else {
-			z = *p;
-			n = 1;
+	a = scalloc(1, sizeof *a);
+	a->a_nstate = nstate;
+	a->a_inp = smalloc(nstate * sizeof *a->a_inp);
+	a->a_root = scalloc(256, sizeof *a->a_root);
+	if ((b->b_flags & AC_LINE) == 0 && b->b_flags & (AC_WORD|AC_SPAN))
+		a->a_olen = smalloc(nstate * sizeof *a->a_olen);
+	a->a_inp[0] = 0;
+	for (i = 0, kid = 1; i < nstate; i++) {
+		q = queue[i].q_w;
+		queue[i].q_s.s_kid = kid;
+		queue[i].q_s.s_fail = q->fail ? q->fail->num : 0;
+		if (q->out)
+			queue[i].q_s.s_fail |= ACOUT;
+		if (a->a_olen)
+			a->a_olen[i] = q->out ? q->olen : 0;
+		for (s = q; s; s = s->link) {
+			if (s->nst == 0)
+				continue;
+			kid++;
+			a->a_inp[s->nst->num] = s->inp;
+			if (i == 0 && (unsigned)s->inp < 256)
+				a->a_root[s->inp] = s->nst->num;
 		}
 	}
+	queue[nstate].q_s.s_kid = nstate;
+	if (sizeof *queue == sizeof *a->a_st)
+		a->a_st = &queue[0].q_s;
+	else {
+		a->a_st = smalloc((nstate + 1) * sizeof *a->a_st);
+		for (i = 0; i <= nstate; i++)
+			a->a_st[i] = queue[i].q_s;
+		free(queue);
+	}
+	afree(&b->b_arena);
+	return a;
+}
+
+/*
+ * Return the state entered from state s on input c, following the
+ * failure function as necessary; set *failed if it was followed.
+ */
+unsigned int ac_next(const struct acaut *a, register unsigned int s,
+		register int c, int *failed)
+{
+	register unsigned int lo, hi, m;
+	register const struct acst *st = a->a_st;
+	register const int *inp = a->a_inp;
+
 	for (;;) {
-	nstate:
-		if (c->inp == (int)z) {
-			c = c->nst;
-		} else if (c->link != 0) {
-			c = c->link;
-			goto nstate;
-		} else {
-			c = c->fail;
-			failed = 1;
-			if (c == 0) {
-				c = w;
-			istate:
-				if (c->inp == (int)z) {
-					c = c->nst;
-				} else if (c->link != 0) {
-					c = c->link;
-					goto istate;
-				}
-			} else
-				goto nstate;
+		if (s == 0 && (unsigned)c < 256) {
+			if ((m = a->a_root[c]) == 0)
+				++*failed;
+			return m;
 		}
-		if (c->out) {
-			if (xflag) {
-				if (failed || p < &line[sz])
-					return 0;
+		lo = st[s].s_kid;
+		hi = st[s + 1].s_kid;
+		if (hi - lo <= 8) {
+			for (; lo < hi; lo++)
+				if (inp[lo] == c)
+					return lo;
+		} else {
+			while (lo < hi) {
+				m = (lo + hi) / 2;
+				if (inp[m] < c)
+					lo = m + 1;
+				else if (inp[m] > c)
+					hi = m;
+				else
+					return m;
 			}
-			return 1;
 		}
-		p += n;
-		if (p >= &line[sz]) {
-			if (z == '\n')
+		++*failed;
+		if (s == 0)
+			return 0;
+		s = st[s].s_fail & ~ACOUT;
+	}
+}
+
+/*
+ * Check whether the character at p (before end) is a word character.
+ */
+static int ac_isword(int flags, const char *p, const char *end)
+{
+	wint_t wc;
+
+	if (p >= end)
+		return 0;
+	if (flags & AC_MB) {
+		if (*p & 0200) {
+			if (mbtowi(&wc, p, end - p) < 0)
 				return 0;
-			else
-				z = '\n';
-		} else {
-			if (*p & 0200) {
-				if ((n = mbtowi(&z, p, &line[sz] - p)) < 0) {
-					n = 1;
-					z = WEOF;
-				}
-			} else {
-				z = *p;
+		} else
+			wc = *p;
+	} else
+		wc = btowc(*p & 0377);
+	return wc == '_' || iswalnum(wc);
+}
+
+/*
+ * Check whether a word begins at sp for -w, as \< would find it.
+ */
+static int ac_wordbeg(int flags, const char *bol, const char *sp,
+		const char *eol)
+{
+	const char *pp, *cp;
+	int n;
+
+	if (sp == bol)
+		return 1;
+	if (!ac_isword(flags, sp, eol))
+		return 0;
+	pp = sp - 1;
+	if (flags & AC_MB) {
+		for (cp = bol; cp < sp; cp += n) {
+			pp = cp;
+			if ((n = mblen(cp, sp - cp)) <= 0)
 				n = 1;
-			}
 		}
 	}
+	return !ac_isword(flags, pp, sp);
 }
 
-static int ac_rangew(struct iblok *ip, char *last)
+/*
+ * With -w, a match is only taken if it would also be found by the
+ * pattern surrounded by \< \> in grep: it must start at the beginning
+ * of the line or with a word character after a non-word character,
+ * and must not be followed by a word character. State c was entered
+ * at the end of the match, me; its fail chain is followed to try each
+ * pattern ending there. The line starts at bol and ends before eol.
+ */
+static int ac_word(const struct acaut *a, unsigned int c, const char *bol,
+		const char *me, const char *eol)
 {
-	register char *p;
+	const char *sp;
+
+	if (ac_isword(a->a_flags, me, eol))
+		return 0;
+	for (; c; c = a->a_st[c].s_fail & ~ACOUT) {
+		if (a->a_olen[c] == 0 || (sp = me - a->a_olen[c]) < bol)
+			continue;
+		if (ac_wordbeg(a->a_flags, bol, sp, eol))
+			return 1;
+	}
+	return 0;
+}
+
+/*
+ * Decide whether a match of state c ending at me is taken. If the
+ * strings came from grep or egrep (see rc_build()), a NUL ends the
+ * line as it does for regexec().
+ */
+int ac_take(const struct acaut *a, unsigned int c, const char *bol,
+		const char *me, const char *eol)
+{
+	if (a->a_flags & AC_NULEOL &&
+			memchr(bol, '\0', (me < eol ? me : eol) - bol) != NULL)
+		return 0;
+	return (a->a_flags & AC_WORD) == 0 || a->a_olen == NULL ||
+		ac_word(a, c, bol, me, eol);
+}
+
+/*
+ * Check a line, which does not include its newline.
+ */
+int ac_exec(const struct acaut *a, const char *line, size_t sz)
+{
+	register const char *p, *end = &line[sz];
+	register unsigned int c;
 	wint_t z;
-	register struct words *c;
-	int failed, n = 0;
+	int failed, n, mb, fold;
 
-	p = ip->ib_cur;
-	lineno++;
+	if (a->a_flags & AC_ALL)
+		return 1;
+	mb = a->a_flags & AC_MB;
+	fold = a->a_flags & AC_FOLD;
 	failed = 0;
-	c = w;
-	for (;;) {
-	nstate:
-		if (*p & 0200) {
-			if ((n = mbtowi(&z, p, last + 1 - p)) < 0) {
+	c = 0;
+	for (p = line; ; p += n) {
+		n = 1;
+		if (p >= end)
+			z = '\n';
+		else if (mb && *p & 0200) {
+			if ((n = mbtowi(&z, p, end - p)) < 0) {
 				n = 1;
 				z = WEOF;
-			}
-		} else {
-			z = *p;
-			n = 1;
-		}
-		if (c->inp == (int)z) {
-			c = c->nst;
-		} else if (c->link != 0) {
-			c = c->link;
-			goto nstate;
+			} else if (fold)
+				z = towlower(z);
 		} else {
-			c = c->fail;
-			failed = 1;
-			if (c == 0) {
-				c = w;
-			istate:
-				if (c->inp == (int)z) {
-					c = c->nst;
-				} else if (c->link != 0) {
-					c = c->link;
-					goto istate;
-				}
-			} else
-				goto nstate;
+			z = *p & 0377;
+			if (fold)
+				z = tolower(z);
 		}
-		if (c->out) {
-			if (xflag) {
-				register char *ep = p;
-				while (*ep != '\n')
-					ep++;
-				if ((failed || ep > p) && vflag == 0) {
-					ip->ib_cur = &ep[1];
-					goto nogood;
-				}
-			}
-			if (vflag == 0) {
-			succeed:
-				outline(ip, last, p - ip->ib_cur);
-				if (qflag || lflag)
-					return 1;
-			} else {
-				ip->ib_cur = p;
-				while (*ip->ib_cur++ != '\n')
-					;
-			}
-		nogood:
-			if ((p = ip->ib_cur) > last)
+		c = ac_next(a, c, (int)z, &failed);
+		if (a->a_st[c].s_fail & ACOUT && ac_take(a, c, line, p + n, end)) {
+			if (a->a_flags & AC_LINE && (failed || p < end))
 				return 0;
-			lineno++;
-			c = w;
-			failed = 0;
-			continue;
-		}
-		p += n;
-		if (p[-n] == '\n') {
-			if (vflag) {
-				p--;
-				goto succeed;
-			}
-			if ((ip->ib_cur = p) > last)
-				return 0;
-			lineno++;
-			c = w;
-			failed = 0;
+			return 1;
 		}
+		if (p >= end)
+			return 0;
 	}
 }
 
-static void cgotofn(void)
+/*
+ * Find the leftmost longest match in line[off..sz) for -o and return 1,
+ * or 0 if there is none. The line is as it was read, not lower-cased.
+ * The automaton must be built with AC_SPAN, so that it is not pruned
+ * and a_olen[] holds the length of the pattern ending in each state.
+ * The patterns that end at a character are found on the fail chain of
+ * the state entered there. Once the root is reached again, no match
+ * can begin before the current character, and the search is over.
+ */
+int ac_span(const struct acaut *a, const char *line, size_t sz, size_t off,
+		size_t *so, size_t *eo)
 {
-	register int c;
-	register struct words *s;
+	const char *p, *sp, *me, *end, *best = NULL, *bend = NULL;
+	unsigned int c, s;
+	wint_t z;
+	int failed, n, mb, fold;
 
-	woverflo();
-	s = smax = w = wcur;
-nword:
-	for (;;) {
-		c = nextch();
-		if (c == EOF)
-			return;
-		if (c == '\n') {
-			if (xflag) {
-				for (;;) {
-					if (s->inp == c) {
-						s = s->nst;
-						break;
-					}
-					if (s->inp == 0)
-						goto nenter;
-					if (s->link == 0) {
-						if (++smax >= &wcur[MAXSIZ])
-							woverflo();
-						s->link = smax;
-						s = smax;
-						goto nenter;
-					}
-					s = s->link;
-				}
-			}
-			s->out = 1;
-			s = w;
+	if (a->a_olen == NULL)
+		return 0;
+	if (a->a_flags & AC_NULEOL && (p = memchr(line, '\0', sz)) != NULL)
+		sz = p - line;
+	end = &line[sz];
+	mb = a->a_flags & AC_MB;
+	fold = a->a_flags & (AC_ICASE|AC_FOLD);
+	failed = 0;
+	c = 0;
+	for (p = &line[off]; p < end; p += n) {
+		n = 1;
+		if (mb && *p & 0200) {
+			if ((n = mbtowi(&z, p, end - p)) < 0) {
+				n = 1;
+				z = WEOF;
+			} else if (fold)
+				z = towlower(z);
 		} else {
-		loop:
-			if (s->inp == c) {
-				s = s->nst;
+			z = *p & 0377;
+			if (fold)
+				z = tolower(z);
+		}
+		c = ac_next(a, c, (int)z, &failed);
+		if (c == 0 && best)
+			break;
+		if ((a->a_st[c].s_fail & ACOUT) == 0)
+			continue;
+		me = p + n;
+		if (a->a_flags & AC_WORD && ac_isword(a->a_flags, me, end))
+			continue;
+		for (s = c; s; s = a->a_st[s].s_fail & ~ACOUT) {
+			if (a->a_olen[s] == 0 || (sp = me - a->a_olen[s]) <
+					&line[off])
 				continue;
+			if (a->a_flags & AC_WORD &&
+					!ac_wordbeg(a->a_flags, line, sp, end))
+				continue;
+			if (best == NULL || sp < best || (sp == best && me > bend)) {
+				best = sp;
+				bend = me;
 			}
-			if (s->inp == 0)
-				goto enter;
-			if (s->link == 0) {
-				if (++smax >= &wcur[MAXSIZ])
-					woverflo();
-				s->link = smax;
-				s = smax;
-				goto enter;
-			}
-			s = s->link;
-			goto loop;
 		}
 	}
-
-enter:
-	do {
-		s->inp = c;
-		if (++smax >= &wcur[MAXSIZ])
-			woverflo();
-		s->nst = smax;
-		s = smax;
-	} while ((c = nextch()) != '\n' && c != EOF);
-	if (xflag) {
-	nenter:
-		s->inp = '\n';
-		if (++smax >= &wcur[MAXSIZ])
-			woverflo();
-		s->nst = smax;
-	}
-	smax->out = 1;
-	s = w;
-	if (c != EOF)
-		goto nword;
+	if (best == NULL)
+		return 0;
+	*so = best - line;
+	*eo = bend - line;
+	return 1;
 }
 
-static void check(int val, int incr)
+/*
+ * Automaton cache. With GREP_CACHEDIR set, the commands save the
+ * automaton in that directory under a hash of the patterns, the flags
+ * it depends on, and the locale, and read it from there instead of
+ * building it when the same hash comes up again (see acgrep.c). The
+ * file holds the arrays made by ac_pack(); they are mapped and used in
+ * place.
+ */
+#define ACMAGIC "grepac2"
+
+struct achdr {
+	char h_magic[8];
+	unsigned long long h_key;
+	unsigned int h_nstate;
+	int h_ssize; /* sizeof (struct acst) */
+};
+
+static unsigned long long fnv(unsigned long long h, const char *s, size_t n)
 {
-	if ((unsigned)(val + incr) >= INT_MAX) {
-		fprintf(stderr, "%s: wordlist too large\n", progname);
-		exit(2);
+	while (n--) {
+		h ^= *s++ & 0377;
+		h *= 1099511628211ULL;
 	}
+	return h;
 }
 
-static void woverflo(void)
+/*
+ * Hash what acnextch() is going to return, plus everything else that
+ * the automaton depends on.
+ */
+unsigned long long ac_key(struct expr *e, int flags)
 {
-	wcur = smax = scalloc(MAXSIZ, sizeof *smax);
-}
+	unsigned long long h = 14695981039346656037ULL;
+	char buf[64];
+	const char *lc;
 
-static void qoverflo(struct words ***queue, int *qsize)
-{
-	check(*qsize, QSIZE);
-	*queue = srealloc(*queue, (*qsize += QSIZE) * sizeof **queue);
+	snprintf(buf, sizeof buf, "%s %d ", ACMAGIC,
+		flags & (AC_ICASE|AC_LINE|AC_WORD|AC_MB|AC_SPAN));
+	h = fnv(h, buf, strlen(buf));
+	if ((lc = setlocale(LC_CTYPE, NULL)) != NULL)
+		h = fnv(h, lc, strlen(lc) + 1);
+	for (; e; e = e->e_nxt) {
+		h = fnv(h, e->e_pat, e->e_len);
+		if (e->e_nxt || e->e_flg & E_NL)
+			h = fnv(h, "\n", 1);
+	}
+	return h;
 }
 
-static void cfail(void)
+/*
+ * Save the automaton to fn; return 1 on success.
+ */
+int ac_save(const struct acaut *a, const char *fn, unsigned long long key)
 {
-	struct words **queue = NULL;
-	int front, rear;
-	int qsize = 0;
-	struct words *state;
-	int bstart;
-	register char c;
-	register struct words *s;
-	qoverflo(&queue, &qsize);
-	s = w;
-	front = rear = 0;
-init:
-	if ((s->inp) != 0) {
-		queue[rear++] = s->nst;
-		if (rear >= qsize - 1)
-			qoverflo(&queue, &qsize);
-	}
-	if ((s = s->link) != 0) {
-		goto init;
-	}
+	struct achdr h;
+	char *tmp;
+	FILE *fp;
+	int ok = 0;
 
-	while (rear != front) {
-		s = queue[front];
-		if (front == qsize - 1)
-			qoverflo(&queue, &qsize);
-		front++;
-	cloop:
-		if ((c = s->inp) != 0) {
-			bstart = 0;
-			q = s->nst;
-			queue[rear] = q;
-			if (front < rear) {
-				if (rear >= qsize - 1)
-					qoverflo(&queue, &qsize);
-				rear++;
-			} else if (++rear == front)
-				qoverflo(&queue, &qsize);
-			state = s->fail;
-		floop:
-			if (state == 0) {
-				state = w;
-				bstart = 1;
-			}
-			if (state->inp == c) {
-			qloop:
-				q->fail = state->nst;
-				if ((state->nst)->out == 1)
-					q->out = 1;
-				if ((q = q->link) != 0)
-					goto qloop;
-			} else if ((state = state->link) != 0)
-				goto floop;
-			else if (bstart == 0) {
-				state = 0;
-				goto floop;
-			}
-		}
-		if ((s = s->link) != 0)
-			goto cloop;
+	tmp = smalloc(strlen(fn) + 24);
+	sprintf(tmp, "%s.%ld", fn, (long)getpid());
+	if ((fp = fopen(tmp, "w")) == NULL) {
+		free(tmp);
+		return 0;
 	}
-	free(queue);
+	memset(&h, 0, sizeof h);
+	memcpy(h.h_magic, ACMAGIC, sizeof h.h_magic);
+	h.h_key = key;
+	h.h_nstate = a->a_nstate;
+	h.h_ssize = sizeof *a->a_st;
+	fwrite(&h, sizeof h, 1, fp);
+	fwrite(a->a_st, sizeof *a->a_st, a->a_nstate + 1, fp);
+	fwrite(a->a_root, sizeof *a->a_root, 256, fp);
+	fwrite(a->a_inp, sizeof *a->a_inp, a->a_nstate, fp);
+	if (a->a_olen)
+		fwrite(a->a_olen, sizeof *a->a_olen, a->a_nstate, fp);
+	if (fclose(fp) == 0 && rename(tmp, fn) == 0)
+		ok = 1;
+	else
+		unlink(tmp);
+	free(tmp);
+	return ok;
 }
 
-/*ARGSUSED*/
-static int a0_match(const char *str, size_t sz)
+/*
+ * Read an automaton built with the given flags from fn, or return
+ * NULL if there is none or it does not fit.
+ */
+struct acaut *ac_load(const char *fn, unsigned long long key, int flags)
 {
-	(void)str;
-	(void)sz;
-	return 0;
-}
+	struct stat sb;
+	struct achdr *h;
+	struct acst *s;
+	struct acaut *a;
+	unsigned int *r, n, i;
+	char *m;
+	int fd, nolen;
 
-/*ARGSUSED*/
-static int a1_match(const char *str, size_t sz)
-{
-	(void)str;
-	(void)sz;
-	return 1;
+	if ((fd = open(fn, O_RDONLY)) < 0)
+		return NULL;
+	if (fstat(fd, &sb) < 0 || sb.st_size < (off_t)sizeof *h ||
+			(m = mmap(NULL, sb.st_size, PROT_READ, MAP_SHARED, fd, 0))
+				== MAP_FAILED) {
+		close(fd);
+		return NULL;
+	}
+	close(fd);
+	h = (struct achdr *)m;
+	n = h->h_nstate;
+	nolen = (flags & AC_LINE) == 0 && flags & (AC_WORD|AC_SPAN) ? n : 0;
+	if (memcmp(h->h_magic, ACMAGIC, sizeof h->h_magic) ||
+			h->h_key != key || h->h_ssize != sizeof *s || n == 0 ||
+			sb.st_size != (off_t)(sizeof *h + (n + 1) * sizeof *s +
+				256 * sizeof *r + (n + nolen) * sizeof (int)))
+		goto bad;
+	/*
+	 * The file might have been damaged; make sure at least that all
+	 * indices are in range and that the failure function leads back
+	 * to the root.
+	 */
+	s = (struct acst *)&h[1];
+	r = (unsigned int *)&s[n + 1];
+	if (s[0].s_kid != 1 || (s[0].s_fail & ~ACOUT) != 0 || s[n].s_kid != n)
+		goto bad;
+	for (i = 1; i < n; i++)
+		if (s[i].s_kid < s[i - 1].s_kid || s[i].s_kid > n ||
+				(s[i].s_fail & ~ACOUT) >= i)
+			goto bad;
+	for (i = 0; i < 256; i++)
+		if (r[i] >= n)
+			goto bad;
+	a = scalloc(1, sizeof *a);
+	a->a_st = s;
+	a->a_root = r;
+	a->a_inp = (int *)&r[256];
+	if (nolen)
+		a->a_olen = &a->a_inp[n];
+	a->a_nstate = n;
+	a->a_flags = flags;
+	a->a_map = m;
+	a->a_mapsz = sb.st_size;
+	return a;
+bad:
+	munmap(m, sb.st_size);
+	return NULL;
 }
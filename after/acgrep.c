@@ -0,0 +1,285 @@
+/*
+ * Aho-Corasick algorithm derived from Unix 32V /usr/src/cmd/fgrep.c,
+ * additionally incorporating the fix from the v7 addenda tape.
+ *
+ * Changes by Gunnar Ritter, Freiburg i. Br., Germany, September 2002.
+ */
+/*
+ * Copyright(C) Caldera International Inc. 2001-2002. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *   Redistributions of source code and documentation must retain the
+ *    above copyright notice, this list of conditions and the following
+ *    disclaimer.
+ *   Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *   All advertising materials mentioning features or use of this software
+ *    must display the following acknowledgement:
+ *      This product includes software developed or owned by Caldera
+ *      International, Inc.
+ *   Neither the name of Caldera International, Inc. nor the names of
+ *    other contributors may be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * USE OF THE SOFTWARE PROVIDED FOR UNDER THIS LICENSE BY CALDERA
+ * INTERNATIONAL, INC. AND CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL CALDERA INTERNATIONAL, INC. BE
+ * LIABLE FOR ANY DIRECT, INDIRECT INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Fixed string search for the commands: sets up the automaton of ac.c
+ * from the options and runs it over the input.
+ */
+
+#include "alloc.h"
+#include "grep.h"
+#include "public.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+
+#include <mbtowi.h>
+
+static struct acaut *acp;
+
+static void ac_build(void);
+static int ac_match(const char *, size_t);
+static int ac_range(struct iblok *, char *);
+static int ac_rangew(struct iblok *, char *);
+static int a0_match(const char *, size_t);
+static int a1_match(const char *, size_t);
+static int ac_spans(const char *, size_t, size_t, size_t *, size_t *);
+
+void ac_select(void)
+{
+	build = ac_build;
+	match = ac_match;
+	matchflags &= ~MF_NULTERM;
+	matchflags |= MF_LOCONV;
+}
+
+static void ac_build(void)
+{
+	struct expr *e;
+	char *dir, *fn = NULL;
+	unsigned long long key = 0;
+	int n, flags, err;
+
+	if (e0->e_flg & E_NULL) {
+		explain("no pattern, no line matches");
+		match = a0_match;
+		return;
+	}
+	patnorm();
+	for (n = 0, e = e0; e; e = e->e_nxt, n++) {
+		if (e->e_len == 0 && !xflag) {
+			explain("empty string, every line matches");
+			match = a1_match;
+			return;
+		}
+	}
+	flags = (iflag ? AC_ICASE : 0) | (xflag ? AC_LINE : 0) |
+		(wflag ? AC_WORD : 0) | (Fflag ? 0 : AC_NULEOL) |
+		(mbcode ? AC_MB : 0) | (oflag && !xflag ? AC_SPAN : 0);
+	if ((dir = getenv("GREP_CACHEDIR")) != NULL && *dir) {
+		key = ac_key(e0, flags);
+		fn = smalloc(strlen(dir) + 24);
+		sprintf(fn, "%s/%016llx.ac", dir, key);
+		if ((acp = ac_load(fn, key, flags)) != NULL)
+			explain("automaton read from %s", fn);
+	}
+	if (acp == NULL) {
+		if ((acp = ac_comp(e0, flags, &err)) == NULL) {
+			if (err == REG_ILLSEQ) {
+				fprintf(stderr, "%s: illegal byte sequence\n",
+					progname);
+				exit(1);
+			}
+			fprintf(stderr, "%s: too many patterns\n", progname);
+			exit(2);
+		}
+		if (fn && ac_save(acp, fn, key))
+			explain("automaton saved to %s", fn);
+	}
+	free(fn);
+	gstats.gs_acstates = acp->a_nstate;
+	span = ac_spans;
+	if (!iflag)
+		range = mbcode ? ac_rangew : ac_range;
+	explain("Aho-Corasick automaton for %d string%s%s", n, n > 1 ? "s" : "",
+		iflag ? ", line by line" : "");
+}
+
+static int ac_match(const char *line, size_t sz)
+{
+	return ac_exec(acp, line, sz);
+}
+
+/*
+ * Find a match for -o.
+ */
+static int ac_spans(const char *line, size_t sz, size_t off,
+		size_t *so, size_t *eo)
+{
+	return ac_span(acp, line, sz, off, so, eo);
+}
+
+static int ac_range(struct iblok *ip, char *last)
+{
+	register char *p;
+	register unsigned int c;
+	register const struct acst *st = acp->a_st;
+	int failed;
+
+	p = ip->ib_cur;
+	lineno++;
+	failed = 0;
+	c = 0;
+	for (;;) {
+		c = ac_next(acp, c, *p & 0377, &failed);
+		if (st[c].s_fail & ACOUT &&
+				ac_take(acp, c, ip->ib_cur, p + 1, last + 1)) {
+			if (xflag) {
+				register char *ep = p;
+				while (*ep != '\n')
+					ep++;
+				if (failed || ep > p) {
+					if (vflag)
+						goto succeed;
+					ip->ib_cur = &ep[1];
+					goto nogood;
+				}
+			}
+			if (vflag == 0) {
+			succeed:
+				outline(ip, last, p - ip->ib_cur);
+				if (enough)
+					return 1;
+			} else {
+				ip->ib_cur = p;
+				while (*ip->ib_cur++ != '\n')
+					;
+			}
+		nogood:
+			gstats.gs_acfail += failed;
+			if ((p = ip->ib_cur) > last)
+				return 0;
+			lineno++;
+			c = 0;
+			failed = 0;
+			continue;
+		}
+		if (*p++ == '\n') {
+			if (vflag) {
+				p--;
+				goto succeed;
+			}
+			gstats.gs_acfail += failed;
+			if ((ip->ib_cur = p) > last)
+				return 0;
+			lineno++;
+			c = 0;
+			failed = 0;
+		}
+	}
+}
+
+static int ac_rangew(struct iblok *ip, char *last)
+{
+	register char *p;
+	wint_t z;
+	register unsigned int c;
+	register const struct acst *st = acp->a_st;
+	int failed, n = 0;
+
+	p = ip->ib_cur;
+	lineno++;
+	failed = 0;
+	c = 0;
+	for (;;) {
+		if (*p & 0200) {
+			if ((n = mbtowi(&z, p, last + 1 - p)) < 0) {
+				n = 1;
+				z = WEOF;
+			}
+		} else {
+			z = *p;
+			n = 1;
+		}
+		c = ac_next(acp, c, (int)z, &failed);
+		if (st[c].s_fail & ACOUT &&
+				ac_take(acp, c, ip->ib_cur, p + n, last + 1)) {
+			if (xflag) {
+				register char *ep = p;
+				while (*ep != '\n')
+					ep++;
+				if (failed || ep > p) {
+					if (vflag)
+						goto succeed;
+					ip->ib_cur = &ep[1];
+					goto nogood;
+				}
+			}
+			if (vflag == 0) {
+			succeed:
+				outline(ip, last, p - ip->ib_cur);
+				if (enough)
+					return 1;
+			} else {
+				ip->ib_cur = p;
+				while (*ip->ib_cur++ != '\n')
+					;
+			}
+		nogood:
+			gstats.gs_acfail += failed;
+			if ((p = ip->ib_cur) > last)
+				return 0;
+			lineno++;
+			c = 0;
+			failed = 0;
+			continue;
+		}
+		p += n;
+		if (p[-n] == '\n') {
+			if (vflag) {
+				p--;
+				goto succeed;
+			}
+			gstats.gs_acfail += failed;
+			if ((ip->ib_cur = p) > last)
+				return 0;
+			lineno++;
+			c = 0;
+			failed = 0;
+		}
+	}
+}
+
+/*ARGSUSED*/
+static int a0_match(const char *str, size_t sz)
+{
+	(void)str;
+	(void)sz;
+	return 0;
+}
+
+/*ARGSUSED*/
+static int a1_match(const char *str, size_t sz)
+{
+	(void)str;
+	(void)sz;
+	return 1;
+}
@@ -76,3 +76,54 @@ void *scalloc(size_t nelem, size_t elsize)
 	}
 	return cp;
 }
+
+#define ABLKSZ (1024 * 1024)
+
+union aalign {
+	long a_l;
+	double a_d;
+	void *a_p;
+};
+
+struct ablk {
+	struct ablk *b_nxt;
+	union aalign b_data[1];
+};
+
+/*
+ * Allocate from an arena.
+ */
+void *aalloc(struct arena *ap, size_t nbytes)
+{
+	struct ablk *bp;
+	size_t sz;
+	char *p;
+
+	nbytes = (nbytes + sizeof(union aalign) - 1) / sizeof(union aalign) *
+		 sizeof(union aalign);
+	if (ap->a_blk == NULL || nbytes > (size_t)(ap->a_end - ap->a_cur)) {
+		sz = nbytes > ABLKSZ ? nbytes : ABLKSZ;
+		bp = scalloc(1, sizeof *bp + sz);
+		bp->b_nxt = ap->a_blk;
+		ap->a_blk = bp;
+		ap->a_cur = (char *)bp->b_data;
+		ap->a_end = &ap->a_cur[sz];
+	}
+	p = ap->a_cur;
+	ap->a_cur += nbytes;
+	return p;
+}
+
+/*
+ * Free all memory of an arena.
+ */
+void afree(struct arena *ap)
+{
+	struct ablk *bp;
+
+	while ((bp = ap->a_blk) != NULL) {
+		ap->a_blk = bp->b_nxt;
+		free(bp);
+	}
+	ap->a_cur = ap->a_end = NULL;
+}
@@ -35,4 +35,17 @@ extern void *smalloc(size_t);
 extern void *srealloc(void *, size_t);
 extern void *scalloc(size_t, size_t);
 
+/*
+ * An arena hands out zero-filled memory from large blocks; it is only
+ * given back as a whole.
+ */
+struct arena {
+	struct ablk *a_blk; /* most recent block */
+	char *a_cur;	    /* free space in it */
+	char *a_end;
+};
+
+extern void *aalloc(struct arena *, size_t);
+extern void afree(struct arena *);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,4 @@
+/*	Auto-generated by make. Do not edit!	*/
+#include	<wchar.h>
+#include	<wctype.h>
+#define	LONGLONG
@@ -0,0 +1,267 @@
+/*
+ * grep - search a file for a pattern
+ *
+ * Gunnar Ritter, Freiburg i. Br., Germany, April 2001.
+ */
+/*
+ * Copyright (c) 2003 Gunnar Ritter
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute
+ * it freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+/*
+ * Context lines around selected lines (-A, -B, -C).
+ *
+ * The kernels only stop at selected lines, so the lines before one are
+ * looked up backwards in the file buffer when it is reported, and the
+ * lines after one are printed when the next is reported or before the
+ * buffer is refilled. Nothing is copied unless the context crosses a
+ * refill: then the last lines of the buffer, and a line that spanned
+ * the refill, are kept in a ring of as many lines as -B asks for.
+ * ctxend is the offset just past the last line printed; lines before
+ * it are never printed again, and a line after it starts a new group.
+ */
+
+#include "alloc.h"
+#include "grep.h"
+#include <stdio.h>
+#include <string.h>
+
+#define	bufoff(ip, p)	((ip)->ib_endoff - ((ip)->ib_end - (p)))
+#define	bufptr(ip, o)	((ip)->ib_end - ((ip)->ib_endoff - (o)))
+
+struct ctxline {
+	char *c_buf;
+	size_t c_size;
+	size_t c_len;
+	off_t c_off;	/* offset in the file */
+	off_t c_lno;	/* line number */
+};
+
+int context;			/* context lines are printed */
+static long actx;		/* -A: lines after */
+static long bctx;		/* -B: lines before */
+static struct ctxline *ring;	/* bctx lines from before the refill */
+static long rhead;		/* next ring slot to fill */
+static long rcnt;		/* lines in the ring */
+static off_t ctxend;		/* just past the last line printed */
+static int cxany;		/* a group was printed */
+static char *base;		/* first complete line in the buffer */
+static char *aftp;		/* next line after, or NULL if at base */
+static long aftleft;		/* lines after still due */
+static off_t aftlno;		/* line number of aftp */
+
+/*
+ * Set up for after and before lines of context; no context is printed
+ * if only counts, names, or matches are.
+ */
+void ctxinit(long after, long before)
+{
+	if (cflag || lflag || qflag || oflag || (after <= 0 && before <= 0))
+		return;
+	context = 1;
+	actx = after > 0 ? after : 0;
+	if ((bctx = before > 0 ? before : 0) > 0)
+		ring = scalloc(bctx, sizeof *ring);
+}
+
+/*
+ * Start on a new file.
+ */
+void ctxfile(void)
+{
+	ctxend = -1;
+	rhead = rcnt = 0;
+	aftp = NULL;
+	aftleft = 0;
+}
+
+/*
+ * A new buffer is searched from ip->ib_cur.
+ */
+void ctxbase(struct iblok *ip)
+{
+	base = ip->ib_cur;
+	if (aftp == NULL)
+		aftp = base;
+}
+
+static void ctxline(const char *line, size_t len, off_t off, off_t lno)
+{
+	if (filename && !hflag)
+		printf("%s-", filename);
+#ifdef LONGLONG
+	if (bflag)
+		printf("%llu-", (long long)(off / BSZ));
+	if (nflag)
+		printf("%llu-", (long long)lno);
+#else  /* !LONGLONG */
+	if (bflag)
+		printf("%lu-", (long)(off / BSZ));
+	if (nflag)
+		printf("%lu-", (long)lno);
+#endif /* !LONGLONG */
+	fwrite(line, sizeof *line, len, stdout);
+	putchar('\n');
+}
+
+static void ctxpush(const char *line, size_t len, off_t off, off_t lno)
+{
+	struct ctxline *cp = &ring[rhead];
+
+	if (len > cp->c_size)
+		cp->c_buf = srealloc(cp->c_buf, cp->c_size = len);
+	memcpy(cp->c_buf, line, len);
+	cp->c_len = len;
+	cp->c_off = off;
+	cp->c_lno = lno;
+	if (++rhead == bctx)
+		rhead = 0;
+	if (rcnt < bctx)
+		rcnt++;
+}
+
+/*
+ * The i-th line in the ring, counted back from the last one.
+ */
+static struct ctxline *ctxback(long i)
+{
+	return &ring[(rhead - 1 - i + bctx) % bctx];
+}
+
+/*
+ * Print the lines after the last selected one that are due, up to upto
+ * in the buffer.
+ */
+void ctxafter(struct iblok *ip, const char *upto)
+{
+	char *nl;
+
+	if (aftp == NULL)
+		aftp = ip->ib_cur;
+	while (aftleft > 0 && aftp < upto &&
+			(nl = memchr(aftp, '\n', upto - aftp)) != NULL) {
+		ctxline(aftp, nl - aftp, bufoff(ip, aftp), aftlno++);
+		aftp = nl + 1;
+		ctxend = bufoff(ip, aftp);
+		aftleft--;
+	}
+}
+
+/*
+ * Print what is due before the selected line at off, which is at sol
+ * in the buffer, or elsewhere if sol is NULL. lineno is its number.
+ */
+void ctxpre(struct iblok *ip, const char *sol, off_t off)
+{
+	const char *p = NULL, *lim, *nl;
+	long n = 0, r = 0;
+	off_t first = off;
+
+	if (sol) {
+		ctxafter(ip, sol);
+		lim = base;
+		if (ctxend > bufoff(ip, lim))
+			lim = bufptr(ip, ctxend);
+		for (p = sol; n < bctx && p > lim; n++)
+			for (p--; p > lim && p[-1] != '\n'; p--)
+				;
+		if (n)
+			first = bufoff(ip, p);
+	}
+	if (n < bctx && (sol == NULL || p == base)) {
+		while (r < rcnt && r < bctx - n && ctxback(r)->c_off >= ctxend)
+			r++;
+		if (r)
+			first = ctxback(r - 1)->c_off;
+	}
+	if (cxany && first != ctxend)
+		puts("--");
+	cxany = 1;
+	while (r-- > 0)
+		ctxline(ctxback(r)->c_buf, ctxback(r)->c_len,
+				ctxback(r)->c_off, ctxback(r)->c_lno);
+	for (; n > 0; n--) {
+		nl = memchr(p, '\n', sol - p);
+		ctxline(p, nl - p, bufoff(ip, p), lineno - n);
+		p = nl + 1;
+	}
+}
+
+/*
+ * The selected line has been printed; the next line is at noff in the
+ * file and at next in the buffer, or at the next base if next is NULL.
+ */
+void ctxpost(char *next, off_t noff)
+{
+	ctxend = noff;
+	aftp = next;
+	aftleft = actx;
+	aftlno = lineno + 1;
+}
+
+/*
+ * Are lines after still due?
+ */
+int ctxdue(void)
+{
+	return aftleft > 0;
+}
+
+/*
+ * A line at off that was not in the buffer has been searched.
+ */
+void ctxpass(const char *line, size_t len, off_t off)
+{
+	if (ctxend > off)
+		return;
+	if (aftleft > 0) {
+		ctxline(line, len, off, aftlno++);
+		ctxend = off + len + 1;
+		aftleft--;
+	} else if (bctx)
+		ctxpush(line, len, off, lineno);
+}
+
+/*
+ * The buffer is about to be refilled, and its complete lines end just
+ * before end. Print the lines after that are due, and keep those that
+ * may be needed before the first selected line of the next buffer.
+ */
+void ctxsave(struct iblok *ip, char *end)
+{
+	char *p, *lim, *nl;
+	long n = 0;
+
+	ctxafter(ip, end);
+	aftp = NULL;
+	if (bctx == 0)
+		return;
+	lim = base;
+	if (ctxend > bufoff(ip, lim))
+		lim = bufptr(ip, ctxend);
+	for (p = end; n < bctx && p > lim; n++)
+		for (p--; p > lim && p[-1] != '\n'; p--)
+			;
+	for (; n > 0; n--) {
+		nl = memchr(p, '\n', end - p);
+		ctxpush(p, nl - p, bufoff(ip, p), lineno - n + 1);
+		p = nl + 1;
+	}
+}
@@ -365,6 +365,7 @@ cgotofn(int s, int c)
 	int st;
 	int curpos, num;
 	int number, newpos;
+	gstats.gs_trans++;
 	n = lastn;
 	cc = iflag ? mbcode && c & ~(wchar_t)0177 ? (int)towlower(c):tolower(c) : c;
 	num = positions[state[s]];
@@ -397,7 +398,9 @@ cgotofn(int s, int c)
 		pos++;
 	}
 	if (notin(n)) {
+		gstats.gs_states++;
 		if (++n >= NSTATES) {
+			gstats.gs_flushes++;
 			n = gotofn[0]['\n'];
 			memset(gotofn, 0, sizeof gotofn);
 			gotofn[0]['\n'] = n;
@@ -561,6 +564,7 @@ eg_build(void)
 	cfoll(line-1);
 	igotofn();
 	range = mbcode ? eg_rangew : eg_range;
+	explain("lazy DFA");
 }
 
 static int
@@ -629,7 +633,7 @@ eg_range(struct iblok *ip, char *last)
 		found:	for (;;) {
 				if (vflag == 0) {
 		succeed:		outline(ip, last, p - ip->ib_cur);
-					if (qflag || lflag)
+					if (enough)
 						return (1);
 				}
 				else {
@@ -688,7 +692,7 @@ eg_rangew(struct iblok *ip, char *last)
 		found:	for (;;) {
 				if (vflag == 0) {
 		succeed:		outline(ip, last, p - ip->ib_cur);
-					if (qflag || lflag)
+					if (enough)
 						return (1);
 				}
 				else {
@@ -727,7 +731,7 @@ init(void)
 {
 	Eflag = 1;
 	eg_select();
-	options = "bce:f:hilnrRvyz";
+	options = "bce:f:hilm:nrRvXyz";
 }
 
 void
@@ -757,11 +761,13 @@ rc_select(void)
 }
 
 char *usagemsg =
-"usage: %s [ -bchilnv ] [ -e exp ] [ -f file ] [ strings ] [ file ] ...\n";
+"usage: %s [ -bchilnvX ] [ -m max ] [ -e exp ] [ -f file ] [ strings ] [ file ] ...\n";
 char *stdinmsg;
 
+#ifndef RANGEBENCH
 int
 main(int argc, char **argv)
 {
 	return grep_run(argc, argv);
-}
\ No newline at end of file
+}
+#endif /* !RANGEBENCH */
\ No newline at end of file
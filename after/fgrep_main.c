@@ -2,14 +2,14 @@
 #include "public.h"
 #include <sys/types.h>
 
-char *usagemsg = "usage: %s [ -bchilnvx ] [ -e exp ] [ -f file ] [ strings ] [ file ] ...\n";
+char *usagemsg = "usage: %s [ -bchilnvwx ] [ -m max ] [ -e exp ] [ -f file ] [ strings ] [ file ] ...\n";
 char *stdinmsg;
 
 void init(void)
 {
 	Fflag = 1;
 	ac_select();
-	options = "bce:f:hilnrRvxyz";
+	options = "bce:f:hilm:nrRvwxyz";
 }
 
 void misop(void)
@@ -32,7 +32,9 @@ void rc_select(void)
 {
 }
 
+#ifndef RANGEBENCH
 int main(int argc, char **argv)
 {
 	return grep_run(argc, argv);
-}
\ No newline at end of file
+}
+#endif /* !RANGEBENCH */
\ No newline at end of file
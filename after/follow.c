@@ -0,0 +1,314 @@
+/*
+ * grep - search a file for a pattern
+ *
+ * Gunnar Ritter, Freiburg i. Br., Germany, April 2001.
+ */
+/*
+ * Copyright (c) 2003 Gunnar Ritter
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute
+ * it freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+/*
+ * Incremental searching of files that only grow (-S, -t).
+ *
+ * For each file searched, its device and inode, the offset and line
+ * number after the last complete line, and a checksum of the bytes
+ * just before that offset are remembered, and are kept in a state
+ * file between runs with -S. The next search of the file starts at
+ * the remembered offset if the file is still the same one, so only
+ * lines added since are searched; if it was replaced, truncated, or
+ * rewritten, it is searched from the start. A last line that lacks
+ * its newline may still be written to, so it is left for the next
+ * search. With -t, the files are searched again whenever they change.
+ */
+
+#include "alloc.h"
+#include "grep.h"
+#include "public.h"
+#include <errno.h>
+#include <libgen.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
+
+#define	FWSUM	64		/* bytes before the offset in the checksum */
+#define	FWHASH	4096		/* hash buckets */
+
+struct fwrec {
+	struct fwrec *r_nxt;	/* next in hash bucket */
+	char *r_name;
+	unsigned long long r_dev;
+	unsigned long long r_ino;
+	unsigned long long r_off;	/* after the last complete line */
+	unsigned long long r_line;	/* line number at r_off */
+	unsigned long long r_size;	/* size when last searched */
+	unsigned long r_sum;
+};
+
+static struct fwrec *fwtab[FWHASH];
+static int infd = -1;		/* inotify descriptor */
+static int fwlost;		/* a watch could not be added */
+
+static unsigned int fwhash(const char *s)
+{
+	unsigned int h = 0;
+
+	while (*s)
+		h = h * 31 + (*s++ & 0377);
+	return h % FWHASH;
+}
+
+static struct fwrec *fwfind(const char *fn, int make)
+{
+	struct fwrec *rp;
+	unsigned int h = fwhash(fn);
+
+	for (rp = fwtab[h]; rp; rp = rp->r_nxt)
+		if (strcmp(rp->r_name, fn) == 0)
+			return rp;
+	if (make == 0)
+		return NULL;
+	rp = scalloc(1, sizeof *rp);
+	rp->r_name = smalloc(strlen(fn) + 1);
+	strcpy(rp->r_name, fn);
+	rp->r_nxt = fwtab[h];
+	fwtab[h] = rp;
+	return rp;
+}
+
+/*
+ * FNV-1a of the bytes before off.
+ */
+static unsigned long fwsum(int fd, unsigned long long off)
+{
+	char buf[FWSUM];
+	unsigned long h = 2166136261UL;
+	size_t n = off < FWSUM ? off : FWSUM;
+	ssize_t i, rd;
+
+	if ((rd = pread(fd, buf, n, off - n)) < 0)
+		return 0;
+	for (i = 0; i < rd; i++)
+		h = ((h ^ (buf[i] & 0377)) * 16777619UL) & 0xffffffffUL;
+	return h;
+}
+
+/*
+ * Read the state file; a missing one is an empty state.
+ */
+void fw_load(const char *sf)
+{
+	FILE *fp;
+	struct fwrec r, *rp;
+	char *name = NULL;
+	size_t n, size = 0;
+	int c;
+
+	if ((fp = fopen(sf, "r")) == NULL) {
+		if (errno == ENOENT)
+			return;
+		fprintf(stderr, "%s: can't open %s\n", progname, sf);
+		exit(2);
+	}
+	while (fscanf(fp, "%llu %llu %llu %llu %lx ", &r.r_dev, &r.r_ino,
+				&r.r_off, &r.r_line, &r.r_sum) == 5) {
+		n = 0;
+		while ((c = getc(fp)) != EOF && c != '\n') {
+			if (n + 1 >= size)
+				name = srealloc(name, size = size ? 2 * size : 256);
+			name[n++] = c;
+		}
+		if (n == 0)
+			break;
+		name[n] = '\0';
+		rp = fwfind(name, 1);
+		rp->r_dev = r.r_dev;
+		rp->r_ino = r.r_ino;
+		rp->r_off = r.r_off;
+		rp->r_line = r.r_line;
+		rp->r_sum = r.r_sum;
+	}
+	if (!feof(fp)) {
+		fprintf(stderr, "%s: bad state file %s\n", progname, sf);
+		exit(2);
+	}
+	fclose(fp);
+	free(name);
+}
+
+/*
+ * Write the state file, replacing the old one only when complete.
+ */
+void fw_save(const char *sf)
+{
+	FILE *fp;
+	struct fwrec *rp;
+	char *tmp;
+	int i;
+
+	tmp = smalloc(strlen(sf) + 24);
+	sprintf(tmp, "%s.%ld", sf, (long)getpid());
+	if ((fp = fopen(tmp, "w")) == NULL) {
+		fprintf(stderr, "%s: can't create %s\n", progname, tmp);
+		exit(2);
+	}
+	for (i = 0; i < FWHASH; i++)
+		for (rp = fwtab[i]; rp; rp = rp->r_nxt)
+			fprintf(fp, "%llu %llu %llu %llu %lx %s\n",
+				rp->r_dev, rp->r_ino, rp->r_off, rp->r_line,
+				rp->r_sum, rp->r_name);
+	if (fclose(fp) != 0 || rename(tmp, sf) != 0) {
+		fprintf(stderr, "%s: can't write %s: %s\n", progname, sf,
+			strerror(errno));
+		unlink(tmp);
+		exit(2);
+	}
+	free(tmp);
+}
+
+/*
+ * Have fn looked after by fw_wait(); a directory for new entries.
+ */
+void fw_watch(const char *fn, int dir)
+{
+#ifdef __linux__
+	if (tflag == 0)
+		return;
+	if (infd < 0 && (infd = inotify_init()) < 0) {
+		fwlost = 1;
+		return;
+	}
+	if (inotify_add_watch(infd, fn, dir ?
+			IN_CREATE | IN_MOVED_TO :
+			IN_MODIFY | IN_ATTRIB | IN_MOVE_SELF | IN_DELETE_SELF) < 0)
+		fwlost = 1;
+#else
+	(void)fn;
+	(void)dir;
+#endif
+}
+
+/*
+ * Watch the directory of a file operand, so that a file that is
+ * created again after rotation is noticed.
+ */
+void fw_watchdir(const char *fn)
+{
+	char *cp;
+
+	cp = smalloc(strlen(fn) + 1);
+	strcpy(cp, fn);
+	fw_watch(dirname(cp), 1);
+	free(cp);
+}
+
+/*
+ * Wait until some file that was searched may have changed.
+ */
+void fw_wait(void)
+{
+#ifdef __linux__
+	struct pollfd pfd;
+	char buf[4096];
+
+	if (infd >= 0) {
+		pfd.fd = infd;
+		pfd.events = POLLIN;
+		if (poll(&pfd, 1, fwlost ? 1000 : -1) > 0)
+			while (read(infd, buf, sizeof buf) == sizeof buf)
+				poll(&pfd, 1, 0);
+		return;
+	}
+#endif
+	sleep(1);
+}
+
+/*
+ * Whether fn is unchanged since it was last searched.
+ */
+int fw_same(const char *fn)
+{
+	struct fwrec *rp;
+	struct stat st;
+
+	return (rp = fwfind(fn, 0)) != NULL && stat(fn, &st) == 0 &&
+		rp->r_dev == (unsigned long long)st.st_dev &&
+		rp->r_ino == (unsigned long long)st.st_ino &&
+		rp->r_size == (unsigned long long)st.st_size;
+}
+
+/*
+ * Position ip for searching fn from where the last search ended, and
+ * set lineno accordingly. Returns 1 if fn is kept track of.
+ */
+int fw_begin(const char *fn, struct iblok *ip)
+{
+	struct fwrec *rp;
+	struct stat st;
+	char *why = NULL;
+
+	if (fn == NULL || strchr(fn, '\n') || fstat(ip->ib_fd, &st) < 0 ||
+			(st.st_mode & S_IFMT) != S_IFREG)
+		return 0;
+	fw_watch(fn, 0);
+	rp = fwfind(fn, 1);
+	if (rp->r_off == 0)
+		;
+	else if (rp->r_dev != (unsigned long long)st.st_dev ||
+			rp->r_ino != (unsigned long long)st.st_ino)
+		why = "was replaced";
+	else if (rp->r_off > (unsigned long long)st.st_size)
+		why = "was truncated";
+	else if (fwsum(ip->ib_fd, rp->r_off) != rp->r_sum)
+		why = "was rewritten";
+	else if (ib_seek(ip, rp->r_off, SEEK_SET) == (off_t)-1)
+		why = "cannot seek";
+	if (why) {
+		explain("%s %s, searching from the start", fn, why);
+		rp->r_off = rp->r_line = 0;
+	} else if (rp->r_off)
+		explain("%s: resuming at line %llu", fn, rp->r_line + 1);
+	rp->r_dev = st.st_dev;
+	rp->r_ino = st.st_ino;
+	lineno = rp->r_line;
+	return 1;
+}
+
+/*
+ * Remember where the search of fn ended; the last held bytes are an
+ * incomplete line.
+ */
+void fw_end(const char *fn, struct iblok *ip, size_t held)
+{
+	struct fwrec *rp;
+
+	if ((rp = fwfind(fn, 0)) == NULL)
+		return;
+	rp->r_size = ip->ib_endoff;
+	rp->r_off = ip->ib_endoff - held;
+	rp->r_line = lineno;
+	rp->r_sum = fwsum(ip->ib_fd, rp->r_off);
+}
@@ -0,0 +1,217 @@
+/*
+ * grep - search a file for a pattern
+ *
+ * Gunnar Ritter, Freiburg i. Br., Germany, April 2001.
+ */
+/*
+ * Copyright (c) 2003 Gunnar Ritter
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute
+ * it freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+/*
+ * Message transfer for grepd and grepc.
+ */
+
+#include "alloc.h"
+#include "grepd.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+/*
+ * Send len bytes at buf on socket s, with the descriptor fd attached
+ * unless it is negative. Returns 0, or -1 on error.
+ */
+int gd_sendfd(int s, const void *buf, size_t len, int fd)
+{
+	struct msghdr mh;
+	struct iovec iov;
+	struct cmsghdr *cm;
+	union {
+		struct cmsghdr u_cm;
+		char u_buf[CMSG_SPACE(sizeof (int))];
+	} cbuf;
+	ssize_t n;
+
+	memset(&mh, 0, sizeof mh);
+	iov.iov_base = (void *)buf;
+	iov.iov_len = len;
+	mh.msg_iov = &iov;
+	mh.msg_iovlen = 1;
+	if (fd >= 0) {
+		memset(&cbuf, 0, sizeof cbuf);
+		mh.msg_control = cbuf.u_buf;
+		mh.msg_controllen = sizeof cbuf.u_buf;
+		cm = CMSG_FIRSTHDR(&mh);
+		cm->cmsg_level = SOL_SOCKET;
+		cm->cmsg_type = SCM_RIGHTS;
+		cm->cmsg_len = CMSG_LEN(sizeof (int));
+		memcpy(CMSG_DATA(cm), &fd, sizeof fd);
+	}
+	while ((n = sendmsg(s, &mh, 0)) < 0)
+		if (errno != EINTR)
+			return -1;
+	return gd_write(s, (const char *)buf + n, len - n);
+}
+
+/*
+ * Receive len bytes into buf from socket s, and a descriptor in *fdp
+ * if one is attached, else -1. Returns 1, 0 at end of file, or -1 on
+ * error.
+ */
+int gd_recvfd(int s, void *buf, size_t len, int *fdp)
+{
+	struct msghdr mh;
+	struct iovec iov;
+	struct cmsghdr *cm;
+	union {
+		struct cmsghdr u_cm;
+		char u_buf[CMSG_SPACE(sizeof (int))];
+	} cbuf;
+	ssize_t n;
+
+	*fdp = -1;
+	memset(&mh, 0, sizeof mh);
+	iov.iov_base = buf;
+	iov.iov_len = len;
+	mh.msg_iov = &iov;
+	mh.msg_iovlen = 1;
+	mh.msg_control = cbuf.u_buf;
+	mh.msg_controllen = sizeof cbuf.u_buf;
+	while ((n = recvmsg(s, &mh, MSG_CMSG_CLOEXEC)) < 0)
+		if (errno != EINTR)
+			return -1;
+	for (cm = CMSG_FIRSTHDR(&mh); cm; cm = CMSG_NXTHDR(&mh, cm))
+		if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_RIGHTS &&
+				cm->cmsg_len == CMSG_LEN(sizeof (int)))
+			memcpy(fdp, CMSG_DATA(cm), sizeof *fdp);
+	if (n == 0)
+		return 0;
+	if ((size_t)n < len && gd_read(s, (char *)buf + n, len - n) != 1) {
+		if (*fdp >= 0)
+			close(*fdp);
+		*fdp = -1;
+		return -1;
+	}
+	return 1;
+}
+
+/*
+ * Read exactly len bytes. Returns 1, 0 at end of file, or -1 on error
+ * or if the file ends within the data.
+ */
+int gd_read(int fd, void *buf, size_t len)
+{
+	char *cp = buf;
+	ssize_t n;
+
+	while (len) {
+		if ((n = read(fd, cp, len)) < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		if (n == 0)
+			return cp == buf ? 0 : -1;
+		cp += n;
+		len -= n;
+	}
+	return 1;
+}
+
+int gd_write(int fd, const void *buf, size_t len)
+{
+	const char *cp = buf;
+	ssize_t n;
+
+	while (len) {
+		if ((n = write(fd, cp, len)) < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		cp += n;
+		len -= n;
+	}
+	return 0;
+}
+
+/*
+ * Name of the server socket: $GREP_SERVER, or "grepd" in the runtime
+ * directory $XDG_RUNTIME_DIR, or else "socket" in a directory of the
+ * user in /tmp, which is made first if mkd is set. Anyone could make
+ * that directory before the user does, so -1 is returned, with *pp
+ * set to its name, unless it belongs to the user and no one else may
+ * enter it.
+ */
+int gd_path(char **pp, int mkd)
+{
+	struct stat st;
+	char *cp;
+	int n;
+
+	if ((cp = getenv("GREP_SERVER")) != NULL && *cp) {
+		*pp = cp;
+		return 0;
+	}
+	if ((cp = getenv("XDG_RUNTIME_DIR")) != NULL && *cp == '/') {
+		*pp = smalloc(strlen(cp) + 7);
+		sprintf(*pp, "%s/grepd", cp);
+		return 0;
+	}
+	*pp = cp = smalloc(48);
+	n = snprintf(cp, 48, "/tmp/grepd-%ld", (long)getuid());
+	if (mkd && mkdir(cp, 0700) < 0 && errno != EEXIST)
+		return -1;
+	if (lstat(cp, &st) < 0)
+		return -1;
+	if (!S_ISDIR(st.st_mode) || st.st_uid != getuid() ||
+			st.st_mode & 077) {
+		errno = EPERM;
+		return -1;
+	}
+	strcpy(&cp[n], "/socket");
+	return 0;
+}
+
+/*
+ * Get the user id of the process at the other end of socket s.
+ */
+int gd_peeruid(int s, uid_t *uid)
+{
+#ifdef SO_PEERCRED
+	struct ucred uc;
+	socklen_t len = sizeof uc;
+
+	if (getsockopt(s, SOL_SOCKET, SO_PEERCRED, &uc, &len) < 0)
+		return -1;
+	*uid = uc.uid;
+	return 0;
+#else	/* !SO_PEERCRED */
+	gid_t gid;
+
+	return getpeereid(s, uid, &gid);
+#endif	/* !SO_PEERCRED */
+}
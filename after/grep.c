@@ -38,13 +38,18 @@
 #include <libgen.h>
 #include <limits.h>
 #include <locale.h>
+#include <signal.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/mman.h>
+#include <sys/resource.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "alloc.h"
@@ -63,24 +68,33 @@ int hflag;				   /* do not print filenames */
 int iflag;				   /* ignore case */
 int lflag;				   /* print filenames only */
 int nflag;				   /* print line numbers */
+int oflag;				   /* print only the matches */
 int qflag;				   /* no output at all */
 int (*rflag)(const char *, struct stat *); /* operate recursively */
 int sflag;				   /* avoid error messages */
+int tflag;				   /* follow growing files */
 int vflag;				   /* inverse selection */
+int cvflag;				   /* -c -v: lines less matching */
+int gapflag;				   /* -v: lines between matches */
 int wflag;				   /* search for words */
 int xflag;				   /* match entire line */
+int Xflag;				   /* explain the search plan */
 int zflag;				   /* decompress compressed files */
 int mb_cur_max;				   /* avoid multiple calls to MB_CUR_MAX */
 int hadpat;				   /* had pattern */
 unsigned status = 1;			   /* exit status */
 off_t lmatch;				   /* count of line matches */
+off_t mcount = -1;			   /* stop after this many matches */
 off_t lineno;				   /* current line number */
 char *progname;				   /* argv[0] to main() */
 char *filename;				   /* name of current file */
+char *Sfile;				   /* state file for -S */
 char *options;				   /* for getopt() */
 void (*build)(void);			   /* compile function */
 int (*match)(const char *, size_t);	   /* comparison function */
 int (*range)(struct iblok *, char *);	   /* grep range of lines */
+int (*span)(const char *, size_t, size_t, size_t *, size_t *);
+					   /* find a match for -o */
 
 /*
  * Regexp variables.
@@ -88,6 +102,13 @@ int (*range)(struct iblok *, char *);	   /* grep range of lines */
 struct expr *e0;	    /* start of expression list */
 enum matchflags matchflags; /* matcher flags */
 
+/*
+ * Statistics for -XX.
+ */
+struct gstats gstats;
+void (*gstathook)(void); /* lets the engine fill in gstats */
+static double tstart;	 /* when grep started */
+
 /*
  * To avoid link loops with -r.
  */
@@ -97,6 +118,51 @@ static struct visit {
 } *visited;
 static int vismax; /* number of members in visited */
 
+/*
+ * Scratch buffers for lines that are not searched in the file buffer.
+ * They are kept from line to line and from file to file, and are only
+ * ever grown, by doubling, so that neither long lines nor many lines
+ * cause allocations once the longest line has been seen.
+ */
+struct scratch {
+	char *s_buf;
+	size_t s_size;
+};
+
+static struct scratch lnbuf; /* line spanning file buffer fills */
+static struct scratch cvbuf; /* line converted to lower case */
+static off_t lnoff;	     /* offset of the line in lnbuf */
+
+/*
+ * With gapflag, the kernels search without -v and only stop at the
+ * lines that match; the runs of lines between them are the ones to be
+ * written, and gapp is the start of the run not yet written.
+ */
+static char *gapp;   /* start of the current run */
+static off_t gaplno; /* line number of gapp */
+
+/*
+ * With -S or -t, every file is read to its end, so -l and -q are done
+ * as -c, and lqflag tells how the count is to be shown.
+ */
+static int lqflag;  /* 'l', 'q', or 0 */
+static int qmatch;  /* had a match with -q */
+static int tracked; /* the current file is searched incrementally */
+static size_t held; /* length of an incomplete last line left over */
+static int stopped; /* the file was not read to its end */
+
+/*
+ * Lines of context, or -1 if not given; -A and -B override -C.
+ */
+static long Actx = -1, Bctx = -1, Cctx = -1;
+
+/*
+ * Patterns for the names of what -r and -R find.
+ */
+static struct nmlist incl;    /* --include: only files matching */
+static struct nmlist excl;    /* --exclude: no files matching */
+static struct nmlist excldir; /* --exclude-dir: no directories matching */
+
 /*
  * Lower-case a character string.
  */
@@ -151,18 +217,19 @@ size_t loconv(register char *dst, register char *src, size_t sz)
 }
 
 /*
- * Determine if pat ends with an unescaped dollar sign.
+ * Describe a step of the search plan on standard error if -X is given.
  */
-static int termdollar(const char *pat, long len)
+void explain(const char *fmt, ...)
 {
-	int dollar = 1;
-
-	if (len == 0 || pat[len - 1] != '$')
-		return 0;
-	pat += --len - 1;
-	while (len-- && *pat-- == '\\')
-		dollar = !dollar;
-	return dollar;
+	va_list ap;
+
+	if (Xflag == 0)
+		return;
+	fprintf(stderr, "%s: plan: ", progname);
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	putc('\n', stderr);
 }
 
 /*
@@ -172,16 +239,8 @@ void wcomp(char **pat, long *len)
 {
 	char *wp = smalloc(*len + 5);
 
-	memcpy(&wp[2], *pat, *len);
-	if ((*pat)[0] == '^')
-		memcpy(wp, "^\\<", 3);
-	else
-		memcpy(wp, "\\<", 2);
-	if (termdollar(*pat, *len))
-		strcpy(&wp[*len - 1 + 2], "\\>$");
-	else
-		strcpy(&wp[*len + 2], "\\>");
-	*len += 4;
+	*len = gl_wrap(wp, *pat, *len);
+	wp[*len] = '\0';
 	*pat = wp;
 }
 
@@ -248,11 +307,69 @@ static struct iblok *redirect(struct iblok *ip, const char *arg0, const char *ar
 	}
 }
 
+static double gsnow(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * Print the statistics for -XX on exit.
+ */
+static void prstats(void)
+{
+	struct rusage ru;
+	double total = gsnow() - tstart;
+
+	if (gstathook)
+		gstathook();
+	fflush(stdout);
+#define	prline(s, v)	if (v) fprintf(stderr, "%s: stats: %s %lld\n", \
+				progname, s, (long long)(v))
+	prline("bytes read", gstats.gs_bytes);
+	prline("lines searched", gstats.gs_lines);
+	prline("buffer fills", gstats.gs_refills);
+	prline("lines copied across fills", gstats.gs_partial);
+	prline("DFA states built", gstats.gs_states);
+	prline("DFA transitions computed", gstats.gs_trans);
+	prline("DFA state cache flushes", gstats.gs_flushes);
+	prline("lines handed to the NFA", gstats.gs_nfa);
+	prline("Aho-Corasick states", gstats.gs_acstates);
+	prline("Aho-Corasick failure transitions", gstats.gs_acfail);
+#undef	prline
+	fprintf(stderr, "%s: stats: seconds compiling %.6f, searching %.6f, "
+			"writing output %.6f\n", progname, gstats.gs_tcomp,
+			total - gstats.gs_tcomp - gstats.gs_tout, gstats.gs_tout);
+	if (getrusage(RUSAGE_SELF, &ru) == 0)
+		fprintf(stderr, "%s: stats: peak memory %ld kB\n", progname,
+				(long)ru.ru_maxrss);
+}
+
+/*
+ * Read the next buffer of input.
+ */
+static int refill(struct iblok *ip)
+{
+	int c;
+
+	if ((c = ib_read(ip)) != EOF) {
+		gstats.gs_refills++;
+		gstats.gs_bytes += ip->ib_end - ip->ib_blk;
+	}
+	return c;
+}
+
 /*
  * Report a matching line.
  */
 void report(const char *line, size_t llen, off_t bcnt, int addnl)
 {
+	double t = 0;
+
+	if (Xflag > 1)
+		t = gsnow();
 	if (filename && !hflag)
 		printf("%s:", filename);
 #ifdef LONGLONG
@@ -270,47 +387,199 @@ void report(const char *line, size_t llen, off_t bcnt, int addnl)
 		fwrite(line, sizeof *line, llen, stdout);
 	if (addnl)
 		putchar('\n');
+	if (Xflag > 1)
+		gstats.gs_tout += gsnow() - t;
 }
 
 /*
- * Check line for match. If necessary, the line gets NUL-terminated (so
- * its address range must be writable then). When ignoring character case,
- * a lower-case-only copy of the line is made instead. If a match is found,
+ * A new buffer is searched from ip->ib_cur.
+ */
+void gapbase(struct iblok *ip)
+{
+	gapp = ip->ib_cur;
+	gaplno = lineno + 1;
+}
+
+/*
+ * Write the lines from gapp up to sol, none of which matched, and start
+ * the next run at next. Without a prefix, a run goes out as one block;
+ * with one, the line numbers are formatted here rather than by printf().
+ */
+void gapout(char *sol, char *next)
+{
+	char num[24], *np, *p, *nl;
+	off_t n;
+	double t = 0;
+
+	if (sol > gapp) {
+		if (Xflag > 1)
+			t = gsnow();
+		if (status == 1)
+			status = 0;
+		if ((filename && !hflag) || nflag)
+			for (p = gapp; p < sol; p = nl + 1) {
+				nl = memchr(p, '\n', sol - p);
+				if (filename && !hflag) {
+					fputs(filename, stdout);
+					putchar(':');
+				}
+				if (nflag) {
+					np = &num[sizeof num];
+					*--np = ':';
+					n = gaplno++;
+					do
+						*--np = '0' + n % 10;
+					while ((n /= 10) != 0);
+					fwrite(np, sizeof *np,
+						&num[sizeof num] - np, stdout);
+				}
+				fwrite(p, sizeof *p, nl + 1 - p, stdout);
+			}
+		else
+			fwrite(gapp, sizeof *gapp, sol - gapp, stdout);
+		if (Xflag > 1)
+			gstats.gs_tout += gsnow() - t;
+	}
+	gapp = next;
+	gaplno = lineno + 1;
+}
+
+/*
+ * Report the matches in a selected line for -o, each on a line of its
+ * own; loff is the offset of the line in the file, and -b prints that
+ * of each match. With -x, the match is the line. Empty matches are not
+ * shown, and lines selected by -v have none.
+ */
+void oreport(const char *line, size_t llen, off_t loff)
+{
+	size_t off, so, eo;
+	double t = 0;
+	int n;
+
+	if (vflag || (span == NULL && !xflag))
+		return;
+	if (Xflag > 1)
+		t = gsnow();
+	for (off = 0; off <= llen; off = eo) {
+		if (xflag) {
+			so = 0;
+			eo = llen;
+		} else if (span(line, llen, off, &so, &eo) == 0)
+			break;
+		if (eo == so) {
+			n = 1;
+			if (mbcode && so < llen && line[so] & 0200 &&
+					(n = mblen(&line[so], llen - so)) <= 0)
+				n = 1;
+			eo = so + n;
+			continue;
+		}
+		if (filename && !hflag)
+			printf("%s:", filename);
+#ifdef LONGLONG
+		if (bflag)
+			printf("%llu:", (long long)(loff + so));
+		if (nflag)
+			printf("%llu:", (long long)lineno);
+#else  /* !LONGLONG */
+		if (bflag)
+			printf("%lu:", (long)(loff + so));
+		if (nflag)
+			printf("%lu:", (long)lineno);
+#endif /* !LONGLONG */
+		fwrite(&line[so], sizeof *line, eo - so, stdout);
+		putchar('\n');
+		if (xflag)
+			break;
+	}
+	if (Xflag > 1)
+		gstats.gs_tout += gsnow() - t;
+}
+
+static void nomem(void)
+{
+	write(2, "Out of memory\n", 14);
+	exit(077);
+}
+
+/*
+ * Make sure the scratch buffer holds at least sz bytes. On failure,
+ * NULL is returned and the buffer is left as it was.
+ */
+static char *sgrow(struct scratch *sp, size_t sz)
+{
+	size_t n;
+	char *np;
+
+	if (sz <= sp->s_size)
+		return sp->s_buf;
+	for (n = sp->s_size ? sp->s_size : 512; n < sz; n *= 2)
+		if (n * 2 < n) {
+			n = sz;
+			break;
+		}
+	if ((np = realloc(sp->s_buf, n)) == NULL)
+		return NULL;
+	sp->s_size = n;
+	return sp->s_buf = np;
+}
+
+/*
+ * Check line for match. If necessary, the line gets NUL-terminated for
+ * the match (so its address range must be writable then); the byte is
+ * put back afterwards since context lines are found by their newlines.
+ * When ignoring character case, a lower-case-only copy of the line is
+ * made in cvbuf instead. If a match is found,
  * statistics are printed. Returns 1 if main loop shall terminate, 0 else.
  */
 static int matchline(char *line, size_t sz, int putnl, struct iblok *ip)
 {
 	size_t csz = sz;
-	int terminate = 0;
-	char lbuf[512], *abuf = NULL, *cline = line;
+	int terminate = 0, matched;
+	char *cline = line;
+	char c = '\0';
 
 	if (iflag && (matchflags & MF_LOCONV)) {
-		if (sz >= sizeof lbuf - 1) {
-			abuf = smalloc(sz + 1);
-			cline = abuf;
-		} else
-			cline = lbuf;
+		if ((cline = sgrow(&cvbuf, sz + 1)) == NULL)
+			nomem();
 		csz = loconv(cline, line, sz);
 		cline[csz] = '\0';
-	} else if (matchflags & MF_NULTERM)
+	} else if (matchflags & MF_NULTERM) {
+		c = cline[sz];
 		cline[sz] = '\0';
+	}
 	lineno++;
-	if (match(cline, csz) ^ vflag) {
+	matched = match(cline, csz);
+	if (cline == line && matchflags & MF_NULTERM)
+		cline[sz] = c;
+	if (matched ^ vflag ^ gapflag) {
 		lmatch++;
 		if (qflag == 0) {
 			if (status == 1)
 				status = 0;
 			if (lflag) {
 				puts(filename ? filename : stdinmsg);
-			} else if (!cflag)
-				report(line, sz, (ib_offs(ip) - 1) / BSZ, putnl);
+			} else if (!cflag) {
+				char *sol = line == lnbuf.s_buf ? NULL : line;
+				off_t off = sol ? ib_offs(ip) - 1 : lnoff;
+
+				if (oflag)
+					oreport(line, sz, off);
+				else {
+					if (context)
+						ctxpre(ip, sol, off);
+					report(line, sz, (ib_offs(ip) - 1) / BSZ,
+						putnl);
+					if (context)
+						ctxpost(sol ? sol + sz + 1 : NULL,
+							off + sz + 1);
+				}
+			}
 		} else
 			exit(0);
-		if (qflag || lflag)
+		if (enough)
 			terminate = 1;
 	}
-	if (abuf)
-		free(abuf);
 	return terminate;
 }
 
@@ -323,8 +592,10 @@ static int gn_range(struct iblok *ip, char *last)
 	char *nl;
 
 	while ((nl = memchr(ip->ib_cur, '\n', last + 1 - ip->ib_cur)) != NULL) {
-		if (matchline(ip->ib_cur, nl - ip->ib_cur, 1, ip))
+		if (matchline(ip->ib_cur, nl - ip->ib_cur, 1, ip)) {
+			ip->ib_cur = nl + 1;
 			return 1;
+		}
 		if (nl == last)
 			return 0;
 		ip->ib_cur = nl + 1;
@@ -332,21 +603,101 @@ static int gn_range(struct iblok *ip, char *last)
 	return 0;
 }
 
+/*
+ * Print the count of matching lines for -c.
+ */
+static void prcount(void)
+{
+	if (lqflag == 'q') {
+		if (lmatch)
+			qmatch = 1;
+	} else if (lqflag == 'l') {
+		if (lmatch)
+			puts(filename ? filename : stdinmsg);
+	} else if (!qflag && cflag && lqflag == 0) {
+		if (filename && !hflag)
+			printf("%s:", filename);
+#ifdef LONGLONG
+		printf("%llu\n", (long long)lmatch);
+#else
+		printf("%lu\n", (long)lmatch);
+#endif
+	}
+}
+
+/*
+ * -m has stopped the search at ip->ib_cur. Print the lines after the
+ * last one selected that are still due, reading on as far as they go;
+ * a line spanning a refill is put together in lnbuf, as in grep().
+ */
+static void ctxtail(struct iblok *ip)
+{
+	char *cp;
+	size_t sz = 0; /* length of the partial line in lnbuf */
+	off_t off = 0; /* its offset */
+
+	for (;;) {
+		if (sz) {
+			if ((cp = memchr(ip->ib_cur, '\n',
+					ip->ib_end - ip->ib_cur)) == NULL)
+				cp = ip->ib_end;
+			if (sgrow(&lnbuf, sz + (cp - ip->ib_cur)) == NULL)
+				nomem();
+			memcpy(&lnbuf.s_buf[sz], ip->ib_cur, cp - ip->ib_cur);
+			sz += cp - ip->ib_cur;
+			ip->ib_cur = cp;
+			if (cp < ip->ib_end) {
+				ctxpass(lnbuf.s_buf, sz, off);
+				sz = 0;
+				ip->ib_cur++;
+			}
+		}
+		if (sz == 0) {
+			ctxbase(ip);
+			for (cp = ip->ib_end; cp > ip->ib_cur && cp[-1] != '\n';
+					cp--)
+				;
+			ctxsave(ip, cp);
+			if (!ctxdue())
+				return;
+			if ((sz = ip->ib_end - cp) > 0) {
+				if (sgrow(&lnbuf, sz) == NULL)
+					nomem();
+				memcpy(lnbuf.s_buf, cp, sz);
+				off = ip->ib_endoff - sz;
+			}
+		}
+		if (refill(ip) == EOF) {
+			if (sz)
+				ctxpass(lnbuf.s_buf, sz, off);
+			return;
+		}
+		ip->ib_cur--;
+	}
+}
+
 /*
  * Main grep routine. The line buffer herein is only used for overlaps
  * between file buffer fills.
  */
 static struct iblok *grep(struct iblok *ip)
 {
-	char *line = NULL;     /* line buffer */
+	char *line = NULL;     /* line buffer, lnbuf if in use */
 	register char *lastnl; /* last newline in file buffer */
 	size_t sz = 0;	       /* length of line in line buffer */
 	char *cp;
 	int hadnl;   /* lastnl points to newline char */
 	int oom = 0; /* got out of memory */
+	off_t line0 = lineno;
+	off_t stopoff;		/* where the search stopped */
+	unsigned ostatus = status;
 
-	lineno = lmatch = 0;
-	if (ib_read(ip) == EOF)
+	lmatch = 0;
+	held = 0;
+	stopped = 0;
+	if (context)
+		ctxfile();
+	if (mcount == 0 || refill(ip) == EOF)
 		goto endgrep;
 	ip->ib_cur--;
 	if (zflag) {
@@ -368,7 +719,7 @@ static struct iblok *grep(struct iblok *ip)
 			else
 				ib_free(ip);
 			ip = np;
-			if (ib_read(ip) == EOF)
+			if (refill(ip) == EOF)
 				goto endgrep;
 			ip->ib_cur--;
 		}
@@ -376,9 +727,17 @@ static struct iblok *grep(struct iblok *ip)
 	for (;;) {
 		for (lastnl = ip->ib_end - 1; *lastnl != '\n' && lastnl > ip->ib_cur; lastnl--)
 			;
+		if (context)
+			ctxbase(ip);
+		if (gapflag)
+			gapbase(ip);
 		if ((hadnl = (ip->ib_cur < ip->ib_end && *lastnl == '\n')))
 			if (range(ip, lastnl))
-				break;
+				goto stop;
+		if (context)
+			ctxsave(ip, hadnl ? lastnl + 1 : ip->ib_cur);
+		if (gapflag && hadnl)
+			gapout(lastnl + 1, lastnl + 1);
 		if (lastnl < ip->ib_end - hadnl) {
 			/*
 			 * Copy the partial line from file buffer to line
@@ -386,16 +745,24 @@ static struct iblok *grep(struct iblok *ip)
 			 * the line later if necessary.
 			 */
 			sz = ip->ib_end - lastnl - hadnl;
-			line = smalloc(sz + 1);
+			if ((line = sgrow(&lnbuf, sz + 1)) == NULL)
+				nomem();
 			memcpy(line, lastnl + hadnl, sz);
 			ip->ib_cur = lastnl + hadnl;
+			lnoff = ip->ib_endoff - sz;
+			gstats.gs_partial++;
 		} else
 			line = NULL;
 	nextbuf:
-		if (ib_read(ip) == EOF) {
+		if (refill(ip) == EOF) {
 			if (line) {
-				matchline(line, sz, sus, ip);
-				free(line);
+				if (tracked)
+					held = sz;
+				else {
+					matchline(line, sz, sus, ip);
+					if (context)
+						ctxpass(line, sz, lnoff);
+				}
 				line = NULL;
 				sz = 0;
 			}
@@ -416,7 +783,7 @@ static struct iblok *grep(struct iblok *ip)
 				 * read the next part of the file.
 				 */
 				sz += ip->ib_end - ip->ib_cur;
-				if ((nline = realloc(line, sz + 1)) == NULL) {
+				if ((nline = sgrow(&lnbuf, sz + 1)) == NULL) {
 					sz = oldsz;
 					cp = &ip->ib_end[-1];
 					oom++;
@@ -429,7 +796,7 @@ static struct iblok *grep(struct iblok *ip)
 			if ((sz = cp - ip->ib_cur) > 0) {
 				char *nline;
 				sz += oldsz;
-				if ((nline = realloc(line, sz + 1)) == NULL) {
+				if ((nline = sgrow(&lnbuf, sz + 1)) == NULL) {
 					sz = oldsz;
 					oom++;
 				} else {
@@ -438,32 +805,70 @@ static struct iblok *grep(struct iblok *ip)
 				}
 			} else
 				sz = oldsz;
-			if (matchline(line, sz, 1, ip))
-				break;
-			free(line);
+			if (matchline(line, sz, 1, ip)) {
+				ip->ib_cur = cp + (oom == 0);
+				goto stop;
+			}
+			if (context)
+				ctxpass(line, sz, lnoff);
 			line = NULL;
 			sz = 0;
 			ip->ib_cur = cp + (oom == 0);
 			oom = 0;
 		}
 	}
+	goto endgrep;
+stop:
+	/*
+	 * The rest of the file is left unread, but for lines of context
+	 * after the last one selected. With -m, stopoff is just past that
+	 * line; a later -S search resumes there, and so does whoever
+	 * reads standard input next.
+	 */
+	stopped = 1;
+	stopoff = ib_offs(ip) - 1;
+	if (context)
+		ctxtail(ip);
+	if (tracked)
+		held = ip->ib_endoff - stopoff;
+	else if (ip->ib_fd == 0 && lmatch == mcount)
+		lseek(0, stopoff - ip->ib_endoff, SEEK_CUR);
 endgrep:
-	if (!qflag && cflag) {
-		if (filename && !hflag)
-			printf("%s:", filename);
-#ifdef LONGLONG
-		printf("%llu\n", (long long)lmatch);
-#else
-		printf("%lu\n", (long)lmatch);
-#endif
+	if (cvflag) {
+		/*
+		 * Matching lines were counted, but the others were
+		 * selected.
+		 */
+		lmatch = lineno - line0 - lmatch;
+		status = ostatus;
+		if (lmatch && status == 1)
+			status = 0;
 	}
+	gstats.gs_lines += lineno - line0;
+	prcount();
 	return ip;
 }
 
 /*
- * Grep a named file.
+ * Is the file or directory at path, with the given name, found by -r
+ * or -R, to be left out?
  */
-static void fngrep(const char *fn, int level)
+static int skipped(const char *path, const char *name, int dir)
+{
+	if (igon && ig_skip(path, name, dir))
+		return 1;
+	if (dir)
+		return excldir.l_any && nm_match(&excldir, name);
+	return (excl.l_any && nm_match(&excl, name)) ||
+		(incl.l_any && !nm_match(&incl, name));
+}
+
+/*
+ * Grep a named file. If base is not NULL, it is the name of the file
+ * in a directory, and the file is skipped if --include, --exclude,
+ * --exclude-dir, or an ignore file say so.
+ */
+static void fngrep(const char *fn, int level, const char *base)
 {
 	struct iblok *ip;
 	struct stat st;
@@ -503,13 +908,18 @@ static void fngrep(const char *fn, int level)
 				return;
 			goto mode;
 		default:
+			if (base && skipped(fn, base, 0))
+				return;
 			break;
 		case S_IFDIR: {
 			char *path;
-			int pend, psize, pi;
+			const char *name;
+			int pend, psize, pi, pushed;
 			DIR *df;
 			struct dirent *dp;
 
+			if (base && skipped(fn, base, 1))
+				return;
 			if (hflag == 2)
 				hflag = 0;
 			if ((df = opendir(fn)) == NULL) {
@@ -522,10 +932,12 @@ static void fngrep(const char *fn, int level)
 					status = 2;
 				return;
 			}
+			fw_watch(fn, 1);
 			pend = strlen(fn);
 			path = malloc(psize = pend + 2);
 			strcpy(path, fn);
 			path[pend++] = '/';
+			pushed = igon && ig_push(fn, pend);
 			while ((dp = readdir(df)) != NULL) {
 				if (dp->d_name[0] == '.' &&
 				    (dp->d_name[1] == '\0' || (dp->d_name[1] == '.' && dp->d_name[2] == '\0')))
@@ -536,15 +948,41 @@ static void fngrep(const char *fn, int level)
 						path = srealloc(path, psize += 14);
 					path[pend + pi] = dp->d_name[pi];
 				} while (dp->d_name[pi++]);
+				/*
+				 * Where the type of the entry is known, the
+				 * name is checked here without a stat().
+				 */
+				name = dp->d_name;
+#ifdef DT_DIR
+				if (dp->d_type == DT_DIR || dp->d_type == DT_REG) {
+					if (skipped(path, name,
+							dp->d_type == DT_DIR))
+						continue;
+					name = NULL;
+				}
+#endif /* DT_DIR */
 				filename = path;
-				fngrep(path, level + 1);
+				fngrep(path, level + 1, name);
 			}
+			if (pushed)
+				ig_pop();
 			free(path);
 			closedir(df);
 			return;
 		}
 		}
 	}
+	if (fn && level == 0 && tflag)
+		fw_watchdir(fn);
+	if (fn && tflag && fw_same(fn))
+		return;
+	if (fn && ix_skip(fn)) {
+		lmatch = 0;
+		prcount();
+		return;
+	}
+	lineno = 0;
+	tracked = 0;
 	if (fn) {
 		if ((ip = ib_open(fn, 0)) == NULL) {
 			if (sflag == 0)
@@ -553,26 +991,143 @@ static void fngrep(const char *fn, int level)
 				status = 2;
 			return;
 		}
+		if (Sfile || tflag)
+			tracked = fw_begin(fn, ip);
 	} else
 		ip = ib_alloc(0, 0);
 	ip = grep(ip);
+	if (tracked)
+		fw_end(fn, ip, held);
 	if (ip->ib_fd) {
 		ib_close(ip);
 		if (zflag && ip->ib_pid) {
 			int s;
+			if (stopped)
+				kill(ip->ib_pid, SIGTERM);
 			waitpid(ip->ib_pid, &s, 0);
-			if (s)
+			if (s && !stopped)
 				status = 2;
 		}
 	} else
 		ib_free(ip);
 }
 
+/*
+ * A count given with an option.
+ */
+static long getcount(const char *s)
+{
+	char *x;
+	long n;
+
+	n = strtol(s, &x, 10);
+	if (*s == '\0' || *x || n < 0) {
+		fprintf(stderr, "%s: bad count %s\n", progname, s);
+		exit(2);
+	}
+	return n;
+}
+
+/*
+ * Add the patterns in a file, one per line, to a list.
+ */
+static void nmfile(struct nmlist *lp, const char *fn)
+{
+	struct iblok *ip;
+	char *line = NULL;
+	size_t size = 0, n;
+
+	if ((ip = ib_open(fn, 0)) == NULL) {
+		fprintf(stderr, "%s: can't open %s\n", progname, fn);
+		exit(2);
+	}
+	while ((n = ib_getlin(ip, &line, &size, srealloc)) != 0) {
+		if (line[n-1] == '\n')
+			line[--n] = '\0';
+		if (n)
+			nm_add(lp, line);
+	}
+	free(line);
+	ib_close(ip);
+}
+
+/*
+ * A long option at argv[optind], with its argument after a '=' or in
+ * the next word.
+ */
+static void longopt(int argc, char **argv)
+{
+	static const struct {
+		const char *o_name;
+		struct nmlist *o_list; /* or NULL for --ignore-file */
+		int o_file; /* the argument names a file of patterns */
+	} lopts[] = {
+		{ "include", &incl, 0 },
+		{ "exclude", &excl, 0 },
+		{ "exclude-from", &excl, 1 },
+		{ "exclude-dir", &excldir, 0 },
+		{ "ignore-file", NULL, 0 },
+		{ NULL, NULL, 0 }
+	};
+	char *arg = &argv[optind++][2], *val;
+	size_t n;
+	int i;
+
+	if (strcmp(arg, "stats") == 0) {
+		/*
+		 * The same as -XX; it takes no argument.
+		 */
+		if (Xflag < 2)
+			Xflag = 2;
+		return;
+	}
+	n = (val = strchr(arg, '=')) != NULL ? (size_t)(val - arg) : strlen(arg);
+	for (i = 0; lopts[i].o_name; i++)
+		if (strlen(lopts[i].o_name) == n &&
+				strncmp(lopts[i].o_name, arg, n) == 0)
+			break;
+	if (lopts[i].o_name == NULL) {
+		fprintf(stderr, "%s: illegal option -- %s\n", progname, arg);
+		usage();
+	}
+	if (val)
+		val++;
+	else if (optind < argc)
+		val = argv[optind++];
+	else {
+		fprintf(stderr, "%s: option requires an argument -- %s\n",
+				progname, arg);
+		usage();
+	}
+	if (lopts[i].o_list == NULL)
+		ig_name(val);
+	else if (lopts[i].o_file)
+		nmfile(lopts[i].o_list, val);
+	else
+		nm_add(lopts[i].o_list, val);
+}
+
 static void parse_args(int argc, char **argv, char *opts)
 {
 	int i = 0;
-	while ((i = getopt(argc, argv, opts)) != EOF) {
+	for (;;) {
+		if (optind < argc && argv[optind][0] == '-' &&
+				argv[optind][1] == '-' && argv[optind][2]) {
+			longopt(argc, argv);
+			continue;
+		}
+		if ((i = getopt(argc, argv, opts)) == EOF)
+			break;
 		switch (i) {
+		case 'A':
+			Actx = getcount(optarg);
+			break;
+		case 'B':
+			Bctx = getcount(optarg);
+			break;
+		case 'C':
+			Cctx = getcount(optarg);
+			break;
 		case 'E':
 			Eflag |= 1;
 			rc_select();
@@ -608,9 +1163,15 @@ static void parse_args(int argc, char **argv, char *opts)
 		case 'l':
 			lflag = 1;
 			break;
+		case 'm':
+			mcount = getcount(optarg);
+			break;
 		case 'n':
 			nflag = 1;
 			break;
+		case 'o':
+			oflag = 1;
+			break;
 		case 'q':
 			qflag = 1;
 			break;
@@ -620,9 +1181,15 @@ static void parse_args(int argc, char **argv, char *opts)
 		case 'R':
 			rflag = lstat;
 			break;
+		case 'S':
+			Sfile = optarg;
+			break;
 		case 's':
 			sflag = 1;
 			break;
+		case 't':
+			tflag = 1;
+			break;
 		case 'v':
 			vflag = 1;
 			break;
@@ -632,6 +1199,9 @@ static void parse_args(int argc, char **argv, char *opts)
 		case 'x':
 			xflag = 1;
 			break;
+		case 'X':
+			Xflag++;
+			break;
 		case 'z':
 			zflag = 1;
 			break;
@@ -643,8 +1213,15 @@ static void parse_args(int argc, char **argv, char *opts)
 	}
 }
 
-int grep_run(int argc, char **argv)
+/*
+ * Everything up to the search: options, patterns, and build(), after
+ * which range is the kernel to search with.
+ */
+void grep_setup(int argc, char **argv)
 {
+	double t;
+
+	tstart = gsnow();
 	hadpat = 0;
 #ifdef __GLIBC__
 	putenv("POSIXLY_CORRECT=1");
@@ -681,9 +1258,25 @@ int grep_run(int argc, char **argv)
 		if (wflag && (Eflag || Fflag))
 			usage();
 	}
+	if (((Sfile || tflag) && zflag) || (tflag && mcount >= 0))
+		usage();
 
 	if (cflag)
 		lflag = 0;
+	if ((Sfile || tflag) && (lflag || qflag)) {
+		lqflag = lflag ? 'l' : 'q';
+		lflag = qflag = 0;
+		cflag = 1;
+	}
+	ctxinit(Actx >= 0 ? Actx : Cctx, Bctx >= 0 ? Bctx : Cctx);
+	/*
+	 * With -c -v and no -m, the lines that match are counted by the
+	 * kernels without -v, so that they do not stop at the others.
+	 */
+	if (cflag && vflag && mcount < 0) {
+		vflag = 0;
+		cvflag = 1;
+	}
 
 	if (hadpat == 0) {
 		if (optind >= argc)
@@ -692,24 +1285,65 @@ int grep_run(int argc, char **argv)
 	} else if (e0 == NULL)
 		patstring(NULL);
 
+	t = gsnow();
 	build();
+	gstats.gs_tcomp = gsnow() - t;
+	/*
+	 * When the lines selected by -v are written as they are, with no
+	 * more than a name and line number before them, the kernels search
+	 * without -v, and the lines between those that match are written
+	 * by the run instead of one by one.
+	 */
+	if (vflag && !cflag && !lflag && !qflag && !oflag && !bflag &&
+			!context && mcount < 0 && range != gn_range) {
+		vflag = 0;
+		gapflag = 1;
+		explain("lines between matches written as runs for -v");
+	}
+	if (Xflag > 1)
+		atexit(prstats);
+}
 
-	if (optind != argc) {
-		if (optind + 1 == argc)
-			hflag = 2;
-		do {
-			if (sus && argv[optind][0] == '-' && argv[optind][1] == '\0') {
-				filename = NULL;
-				fngrep(NULL, 0);
-			} else {
-				filename = argv[optind];
-				fngrep(argv[optind], 0);
+int grep_run(int argc, char **argv)
+{
+	int i;
+
+	grep_setup(argc, argv);
+	if (Sfile)
+		fw_load(Sfile);
+
+	for (;;) {
+		if (optind != argc) {
+			if (optind + 1 == argc)
+				hflag = 2;
+			for (i = optind; i < argc; i++) {
+				if (sus && argv[i][0] == '-' && argv[i][1] == '\0') {
+					filename = NULL;
+					fngrep(NULL, 0, NULL);
+				} else {
+					filename = argv[i];
+					fngrep(argv[i], 0, NULL);
+				}
 			}
-		} while (++optind < argc);
-	} else {
-		if (lflag && !sus && (Eflag || Fflag))
-			exit(1);
-		fngrep(NULL, 0);
+		} else {
+			if (lflag && !sus && (Eflag || Fflag))
+				exit(1);
+			fngrep(NULL, 0, NULL);
+		}
+		if (Sfile)
+			fw_save(Sfile);
+		if (qmatch) {
+			status = 0;
+			break;
+		}
+		if (tflag == 0 || optind == argc)
+			break;
+		/*
+		 * Files that cannot be opened now may appear later.
+		 */
+		fflush(stdout);
+		sflag = 1;
+		fw_wait();
 	}
 
 	return status;
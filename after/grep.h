@@ -65,6 +65,26 @@ enum matchflags {
 	MF_LOCONV = 02	 /* lower-case search string if -i is set */
 };
 
+/*
+ * Statistics for -XX. Only what happens off the inner loops of the
+ * kernels is counted there, or once per line at most, so that they
+ * cost next to nothing when not asked for.
+ */
+struct gstats {
+	long long gs_bytes;    /* bytes read */
+	long long gs_lines;    /* lines searched */
+	long long gs_refills;  /* buffer fills */
+	long long gs_partial;  /* lines copied across fills */
+	long long gs_states;   /* DFA states built */
+	long long gs_flushes;  /* DFA state cache flushes */
+	long long gs_trans;    /* DFA transitions computed */
+	long long gs_nfa;      /* lines handed to the NFA */
+	long long gs_acstates; /* Aho-Corasick states */
+	long long gs_acfail;   /* Aho-Corasick failure transitions */
+	double gs_tcomp;       /* seconds spent compiling */
+	double gs_tout;	       /* seconds spent writing output */
+};
+
 /*
  * Variables in grep.c.
  */
@@ -77,22 +97,35 @@ extern int hflag;		/* do not print filenames */
 extern int iflag;		/* ignore case */
 extern int lflag;		/* print filenames only */
 extern int nflag;		/* print line numbers */
+extern int oflag;		/* print only the matches */
 extern int qflag;		/* no output at all */
 extern int sflag;		/* avoid error messages */
+extern int tflag;		/* follow growing files */
 extern int vflag;		/* inverse selection */
+extern int cvflag;		/* -c -v: lines less those matching */
+extern int gapflag;		/* -v: the lines between matches */
 extern int wflag;		/* search for words */
 extern int xflag;		/* match entire line */
+extern int zflag;		/* decompress compressed files */
+extern int Xflag;		/* explain the search plan */
 extern int mb_cur_max;		/* MB_CUR_MAX */
 #define mbcode (mb_cur_max > 1) /* multibyte characters in use */
+#define enough (qflag || lflag || lmatch == mcount) /* stop the file */
 extern unsigned status;		/* exit status */
 extern off_t lmatch;		/* count of matching lines */
+extern off_t mcount;		/* -m: stop after this many, or -1 */
 extern off_t lineno;		/* current line number */
 // extern char *progname;			     /* argv[0] to main() */
 extern char *filename;			     /* name of current file */
+extern char *Sfile;			     /* state file for -S */
 extern void (*build)(void);		     /* compile function */
 extern int (*match)(const char *, size_t);   /* comparison */
 extern int (*range)(struct iblok *, char *); /* grep range */
+extern int (*span)(const char *, size_t, size_t, size_t *, size_t *);
+					     /* find a match for -o */
 extern struct expr *e0;			     /* start of expression list */
+extern struct gstats gstats;		     /* statistics for -XX */
+extern void (*gstathook)(void);		     /* completes gstats */
 extern enum matchflags matchflags;	     /* matcher flags */
 
 /*
@@ -107,9 +140,82 @@ extern char *options;  /* for getopt() */
  * In grep.c.
  */
 // extern int grep_run(int argc, char **argv);
+extern void grep_setup(int, char **);
 extern size_t loconv(char *, char *, size_t);
 extern void wcomp(char **, long *);
+extern void explain(const char *, ...);
 extern void report(const char *, size_t, off_t, int);
+extern void oreport(const char *, size_t, off_t);
+extern void gapbase(struct iblok *);
+extern void gapout(char *, char *);
+
+/*
+ * In patset.c.
+ */
+extern int gl_fixedset(struct expr *, int);
+extern size_t gl_wrap(char *, const char *, size_t);
+
+/*
+ * In trigram.c.
+ */
+extern int ix_skip(const char *);
+
+/*
+ * In follow.c.
+ */
+extern void fw_load(const char *);
+extern void fw_save(const char *);
+extern void fw_watch(const char *, int);
+extern void fw_watchdir(const char *);
+extern void fw_wait(void);
+extern int fw_same(const char *);
+extern int fw_begin(const char *, struct iblok *);
+extern void fw_end(const char *, struct iblok *, size_t);
+
+/*
+ * In context.c.
+ */
+extern int context;	/* context lines are printed */
+extern void ctxinit(long, long);
+extern void ctxfile(void);
+extern void ctxbase(struct iblok *);
+extern void ctxafter(struct iblok *, const char *);
+extern void ctxpre(struct iblok *, const char *, off_t);
+extern void ctxpost(char *, off_t);
+extern int ctxdue(void);
+extern void ctxpass(const char *, size_t, off_t);
+extern void ctxsave(struct iblok *, char *);
+
+/*
+ * In names.c.
+ */
+struct nmset {
+	struct nment **s_tab;
+	unsigned s_size;	/* a power of two, or 0 */
+	unsigned s_cnt;
+};
+
+struct nmlist {
+	struct nmset l_name;	/* plain names */
+	struct nmset l_suf;	/* suffixes, from "*suffix" */
+	struct nmset l_pre;	/* prefixes, from "prefix*" */
+	char **l_pat;		/* all other patterns, for gmatch() */
+	int l_npat;
+	int l_any;		/* any pattern was added */
+};
+
+extern void nm_add(struct nmlist *, const char *);
+extern int nm_match(const struct nmlist *, const char *);
+extern void nm_free(struct nmlist *);
+
+/*
+ * In ignore.c.
+ */
+extern int igon;	/* ignore files are read */
+extern void ig_name(const char *);
+extern int ig_push(const char *, size_t);
+extern void ig_pop(void);
+extern int ig_skip(const char *, const char *, int);
 
 /*
  * Flavor dependent.
@@ -129,6 +235,59 @@ extern void eg_select(void);
  */
 extern void ac_select(void);
 
+/*
+ * Aho-Corasick automaton, packed into arrays indexed by state number.
+ * States are numbered breadth first with the children of each state
+ * in order of their input character, so they follow each other and
+ * the transitions of state s lead to the states from st[s].s_kid to
+ * st[s+1].s_kid - 1; a_inp[] holds the input character by which a
+ * state is entered. State 0 is the root, which is also the failure
+ * state of those that have none. All states close to the root come
+ * first, and they are the ones visited most of the time. Once built,
+ * an automaton is only read, so it may be shared between threads.
+ */
+struct acst {
+	unsigned int s_kid;  /* first child */
+	unsigned int s_fail; /* failure state, or'ed with ACOUT */
+};
+
+#define ACOUT	0x80000000U	/* a pattern is found in this state */
+
+struct acaut {
+	struct acst *a_st;	/* a_nstate + 1 entries */
+	int *a_inp;
+	int *a_olen;		/* with AC_WORD or AC_SPAN: length of a pattern
+				   ending here */
+	unsigned int *a_root;	/* transitions of the root by byte */
+	unsigned int a_nstate;
+	int a_flags;		/* enum acflags */
+	char *a_map;		/* mapped from the cache, see ac_load() */
+	size_t a_mapsz;
+};
+
+enum acflags {
+	AC_ICASE = 01,	/* patterns are lower-cased */
+	AC_FOLD = 02,	/* ac_exec() lower-cases the line */
+	AC_LINE = 04,	/* match entire lines */
+	AC_WORD = 010,	/* match words */
+	AC_NULEOL = 020,	/* a NUL ends the line */
+	AC_MB = 040,	/* multibyte characters in use */
+	AC_ALL = 0100,	/* an empty string matches every line */
+	AC_SPAN = 0200	/* for ac_span(): no pruning, a_olen[] kept */
+};
+
+extern struct acaut *ac_comp(struct expr *, int, int *);
+extern void ac_free(struct acaut *);
+extern unsigned int ac_next(const struct acaut *, unsigned int, int, int *);
+extern int ac_take(const struct acaut *, unsigned int, const char *,
+		const char *, const char *);
+extern int ac_exec(const struct acaut *, const char *, size_t);
+extern int ac_span(const struct acaut *, const char *, size_t, size_t,
+		size_t *, size_t *);
+extern unsigned long long ac_key(struct expr *, int);
+extern struct acaut *ac_load(const char *, unsigned long long, int);
+extern int ac_save(const struct acaut *, const char *, unsigned long long);
+
 /*
  * compile()/step()-related.
  */
@@ -142,9 +301,12 @@ extern void rc_select(void);
 /*
  * Not for SVID3 grep.
  */
+extern struct arena patarena; /* compile-time structures */
 extern void patstring(char *);
 extern void patfile(char *);
+extern void patnorm(void);
 extern int nextch(void);
 extern void outline(struct iblok *, char *, size_t);
+extern size_t nlcount(const char *, const char *);
 
 #endif
\ No newline at end of file
@@ -6,7 +6,7 @@
 #include <string.h>
 #include <sys/types.h>
 
-char *usagemsg = "Usage: %s -hblcnsvi pattern file . . .\n";
+char *usagemsg = "Usage: %s -hblcnsvi [-m max] pattern file . . .\n";
 char *stdinmsg = "<stdin>";
 
 /*
@@ -120,7 +120,7 @@ void patstring(char *pat)
 void init(void)
 {
 	st_select();
-	options = "bchilnrRsvwyz";
+	options = "bchilm:nrRsvwyz";
 }
 
 void misop(void)
@@ -146,7 +146,9 @@ void rc_select(void)
 {
 }
 
+#ifndef RANGEBENCH
 int main(int argc, char **argv)
 {
 	return grep_run(argc, argv);
 }
+#endif /* !RANGEBENCH */
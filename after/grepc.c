@@ -0,0 +1,308 @@
+/*
+ * grep - search a file for a pattern
+ *
+ * Gunnar Ritter, Freiburg i. Br., Germany, April 2001.
+ */
+/*
+ * Copyright (c) 2003 Gunnar Ritter
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute
+ * it freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+/*
+ * grepc - search through grepd
+ *
+ * Takes the options of new grep, but has the search done by a running
+ * grepd, which keeps compiled patterns between calls. Files are opened
+ * here and passed to the server, which writes the output straight to
+ * our standard output.
+ */
+
+#include "alloc.h"
+#include "grepd.h"
+#include "public.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <locale.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+char *progname;
+
+static char *pats;		/* newline-separated patterns */
+static size_t patlen;
+static int npat;		/* patterns given */
+static int flags;		/* GREP_* */
+static int out;			/* GD_* */
+static int sflag;
+static unsigned status = 1;
+
+static void usage(void)
+{
+	fprintf(stderr, "%s: Usage:\n\
+     [-E|-F] [-c|-l|-q] [-bhinsvwx] pattern [file ...]\n\
+     [-E|-F] [-c|-l|-q] [-bhinsvwx] -e pattern ... [-f file ...] [file ...]\n\
+     [-E|-F] [-c|-l|-q] [-bhinsvwx] -f file ... [-e pattern ...] [file ...]\n",
+		progname);
+	exit(2);
+}
+
+static void addpat(const char *s, size_t n)
+{
+	pats = srealloc(pats, patlen + n + 1);
+	if (npat++)
+		pats[patlen++] = '\n';
+	memcpy(&pats[patlen], s, n);
+	patlen += n;
+}
+
+/*
+ * Add the lines of a pattern file.
+ */
+static void addfile(const char *fn)
+{
+	struct stat st;
+	char *buf;
+	size_t n;
+	int fd;
+
+	if ((fd = open(fn, O_RDONLY)) < 0 || fstat(fd, &st) < 0) {
+		fprintf(stderr, "%s: can't open %s\n", progname, fn);
+		exit(2);
+	}
+	buf = smalloc(st.st_size + 1);
+	if (gd_read(fd, buf, st.st_size) < 0) {
+		fprintf(stderr, "%s: read error on %s: %s\n", progname, fn,
+			strerror(errno));
+		exit(2);
+	}
+	close(fd);
+	if ((n = st.st_size) > 0) {
+		if (buf[n - 1] == '\n')
+			n--;
+		addpat(buf, n);
+	}
+	free(buf);
+}
+
+/*
+ * Connect to the server, which must be run by the same user, as our
+ * output and files are passed to it.
+ */
+static int connectd(void)
+{
+	struct sockaddr_un sa;
+	char *path;
+	uid_t uid;
+	int s;
+
+	if (gd_path(&path, 0) < 0 || (s = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+		fprintf(stderr, "%s: cannot connect to %s: %s\n", progname, path,
+			strerror(errno));
+		exit(2);
+	}
+	memset(&sa, 0, sizeof sa);
+	sa.sun_family = AF_UNIX;
+	strncpy(sa.sun_path, path, sizeof sa.sun_path - 1);
+	if (connect(s, (struct sockaddr *)&sa, sizeof sa) < 0 ||
+			gd_peeruid(s, &uid) < 0) {
+		fprintf(stderr, "%s: cannot connect to %s: %s\n", progname, path,
+			strerror(errno));
+		exit(2);
+	}
+	if (uid != getuid()) {
+		fprintf(stderr, "%s: server on %s is run by user %ld\n",
+			progname, path, (long)uid);
+		exit(2);
+	}
+	return s;
+}
+
+static void lost(void)
+{
+	fprintf(stderr, "%s: lost connection to server\n", progname);
+	exit(2);
+}
+
+/*
+ * Have the server search one file; fn is NULL for standard input.
+ */
+static void search(int s, const char *fn)
+{
+	struct gd_file fr;
+	struct gd_rep rp;
+	int fd;
+
+	if (fn == NULL)
+		fd = 0;
+	else if ((fd = open(fn, O_RDONLY)) < 0) {
+		if (sflag == 0)
+			fprintf(stderr, "%s: can't open %s\n", progname, fn);
+		if (!(out & GD_QUIET) || status == 1)
+			status = 2;
+		return;
+	}
+	fr.f_namelen = fn ? strlen(fn) : 0;
+	if (gd_sendfd(s, &fr, sizeof fr, fd) < 0 ||
+			(fn && gd_write(s, fn, fr.f_namelen) < 0))
+		lost();
+	if (fd)
+		close(fd);
+	if (gd_read(s, &rp, sizeof rp) != 1)
+		lost();
+	if (rp.p_err) {
+		if (sflag == 0)
+			fprintf(stderr, "%s: read error on %s: %s\n", progname,
+				fn ? fn : "(standard input)", strerror(rp.p_err));
+		if (!(out & GD_QUIET) || status == 1)
+			status = 2;
+	} else if (rp.p_count > 0) {
+		if (out & GD_QUIET)
+			exit(0);
+		if (status == 1)
+			status = 0;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	struct gd_req rq;
+	struct gd_rep rp;
+	char *msg;
+	int c, s, hadpat = 0, hflag = 0;
+
+	progname = basename(argv[0]);
+	setlocale(LC_COLLATE, "");
+	setlocale(LC_CTYPE, "");
+	while ((c = getopt(argc, argv, "EFbce:f:hilnqsvwxy")) != EOF) {
+		switch (c) {
+		case 'E':
+			flags |= GREP_EXTENDED;
+			break;
+		case 'F':
+			flags |= GREP_FIXED;
+			break;
+		case 'b':
+			out |= GD_BLOCK;
+			break;
+		case 'c':
+			out |= GD_COUNT;
+			break;
+		case 'e':
+			addpat(optarg, strlen(optarg));
+			hadpat++;
+			break;
+		case 'f':
+			addfile(optarg);
+			hadpat++;
+			break;
+		case 'h':
+			hflag = 1;
+			break;
+		case 'i':
+		case 'y':
+			flags |= GREP_ICASE;
+			break;
+		case 'l':
+			out |= GD_LIST;
+			break;
+		case 'n':
+			out |= GD_NUM;
+			break;
+		case 'q':
+			out |= GD_QUIET;
+			break;
+		case 's':
+			sflag = 1;
+			break;
+		case 'v':
+			flags |= GREP_INVERT;
+			break;
+		case 'w':
+			flags |= GREP_WORD;
+			break;
+		case 'x':
+			flags |= GREP_LINE;
+			break;
+		default:
+			usage();
+		}
+	}
+	if ((flags & (GREP_EXTENDED|GREP_FIXED)) == (GREP_EXTENDED|GREP_FIXED) ||
+			((out & GD_COUNT) != 0) + ((out & GD_LIST) != 0) +
+				((out & GD_QUIET) != 0) > 1 ||
+			(flags & GREP_WORD && flags & (GREP_EXTENDED|GREP_FIXED)))
+		usage();
+	if (hadpat == 0) {
+		if (optind >= argc)
+			usage();
+		addpat(argv[optind], strlen(argv[optind]));
+		optind++;
+	}
+	if (npat == 0) {
+		/*
+		 * Only empty pattern files; no line matches with -F, and
+		 * it is an error otherwise, as in rc_build().
+		 */
+		if ((flags & GREP_FIXED) == 0) {
+			fprintf(stderr, "%s: RE error: empty pattern\n", progname);
+			exit(2);
+		}
+		flags = (flags & ~(GREP_LINE|GREP_WORD)) ^ GREP_INVERT;
+		addpat("", 0);
+	}
+	if (argc - optind > 1 && hflag == 0)
+		out |= GD_NAME;
+	if (patlen > GD_MAXPAT) {
+		fprintf(stderr, "%s: patterns too long\n", progname);
+		exit(2);
+	}
+	s = connectd();
+	memset(&rq, 0, sizeof rq);
+	rq.r_magic = GD_MAGIC;
+	rq.r_flags = flags;
+	rq.r_out = out;
+	rq.r_patlen = patlen;
+	if (gd_sendfd(s, &rq, sizeof rq, 1) < 0 ||
+			(patlen && gd_write(s, pats, patlen) < 0) ||
+			gd_read(s, &rp, sizeof rp) != 1)
+		lost();
+	if (rp.p_err) {
+		msg = smalloc(rp.p_msglen + 1);
+		if (rp.p_msglen && gd_read(s, msg, rp.p_msglen) != 1)
+			lost();
+		msg[rp.p_msglen] = '\0';
+		fprintf(stderr, "%s: RE error: %s\n", progname, msg);
+		exit(2);
+	}
+	if (optind == argc)
+		search(s, NULL);
+	else
+		for (; optind < argc; optind++)
+			search(s, strcmp(argv[optind], "-") ? argv[optind] : NULL);
+	shutdown(s, SHUT_WR);
+	close(s);
+	return status;
+}
@@ -0,0 +1,429 @@
+/*
+ * grep - search a file for a pattern
+ *
+ * Gunnar Ritter, Freiburg i. Br., Germany, April 2001.
+ */
+/*
+ * Copyright (c) 2003 Gunnar Ritter
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute
+ * it freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+/*
+ * grepd - search server
+ *
+ * Keeps compiled pattern sets, together with scanners whose lazy DFAs
+ * have already been filled in, between requests from grepc, so that
+ * repeated searches with the same heavy pattern set do not pay for
+ * process startup and compilation each time. Files are opened by the
+ * client and passed over the socket, see grepd.h.
+ */
+
+#include "alloc.h"
+#include "grepd.h"
+#include "public.h"
+#include <errno.h>
+#include <libgen.h>
+#include <limits.h>
+#include <locale.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define GD_NCACHE 32 /* pattern sets kept */
+#define BSZ 512 /* block size for -b, as in grep.h */
+
+char *progname;
+static const char *stdinmsg = "(standard input)";
+
+/*
+ * A cached pattern set, with the scanners that are not in use.
+ */
+struct gd_pat {
+	struct gd_pat *c_nxt;
+	char *c_pats;
+	size_t c_len;
+	int c_flags;
+	grep_pat *c_pat;
+	struct gd_scan *c_idle;
+	int c_users;
+};
+
+struct gd_scan {
+	struct gd_scan *s_nxt;
+	grep_scan *s_scan;
+};
+
+static struct gd_pat *cache; /* most recently used first */
+static pthread_mutex_t cachelock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Buffered output to the standard output of the client.
+ */
+struct gd_out {
+	int o_fd;
+	int o_err;
+	size_t o_n;
+	char o_buf[8192];
+};
+
+struct gd_job {
+	struct gd_out *j_out;
+	int j_mode;		/* enum gdout */
+	const char *j_name;	/* NULL for standard input */
+};
+
+static void gd_evict(void)
+{
+	struct gd_pat *cp, **pp, **victim = NULL;
+	struct gd_scan *sp;
+	int n = 0;
+
+	for (pp = &cache; *pp; pp = &(*pp)->c_nxt)
+		if (++n > GD_NCACHE && (*pp)->c_users == 0)
+			victim = pp;
+	if (victim == NULL)
+		return;
+	cp = *victim;
+	*victim = cp->c_nxt;
+	while ((sp = cp->c_idle) != NULL) {
+		cp->c_idle = sp->s_nxt;
+		grep_scan_free(sp->s_scan);
+		free(sp);
+	}
+	grep_free(cp->c_pat);
+	free(cp->c_pats);
+	free(cp);
+}
+
+/*
+ * Look up a pattern set, compiling it if it is not cached. The entry
+ * stays in the cache while it is in use; give it back with gd_put().
+ */
+static struct gd_pat *gd_get(const char *pats, size_t len, int flags, int *err)
+{
+	struct gd_pat *cp, **pp;
+	grep_pat *p;
+
+	pthread_mutex_lock(&cachelock);
+	for (pp = &cache; (cp = *pp) != NULL; pp = &cp->c_nxt)
+		if (cp->c_flags == flags && cp->c_len == len &&
+				memcmp(cp->c_pats, pats, len) == 0) {
+			*pp = cp->c_nxt;
+			cp->c_nxt = cache;
+			cache = cp;
+			cp->c_users++;
+			pthread_mutex_unlock(&cachelock);
+			return cp;
+		}
+	pthread_mutex_unlock(&cachelock);
+	if ((p = grep_comp(pats, len, flags, err)) == NULL)
+		return NULL;
+	cp = scalloc(1, sizeof *cp);
+	cp->c_pats = smalloc(len + 1);
+	memcpy(cp->c_pats, pats, len);
+	cp->c_len = len;
+	cp->c_flags = flags;
+	cp->c_pat = p;
+	cp->c_users = 1;
+	pthread_mutex_lock(&cachelock);
+	cp->c_nxt = cache;
+	cache = cp;
+	gd_evict();
+	pthread_mutex_unlock(&cachelock);
+	return cp;
+}
+
+static void gd_put(struct gd_pat *cp)
+{
+	pthread_mutex_lock(&cachelock);
+	cp->c_users--;
+	gd_evict();
+	pthread_mutex_unlock(&cachelock);
+}
+
+static grep_scan *gd_scan(struct gd_pat *cp)
+{
+	struct gd_scan *sp;
+	grep_scan *s;
+
+	pthread_mutex_lock(&cachelock);
+	if ((sp = cp->c_idle) != NULL)
+		cp->c_idle = sp->s_nxt;
+	pthread_mutex_unlock(&cachelock);
+	if (sp == NULL)
+		return grep_scan_new(cp->c_pat);
+	s = sp->s_scan;
+	free(sp);
+	return s;
+}
+
+static void gd_unscan(struct gd_pat *cp, grep_scan *s)
+{
+	struct gd_scan *sp;
+
+	sp = smalloc(sizeof *sp);
+	sp->s_scan = s;
+	pthread_mutex_lock(&cachelock);
+	sp->s_nxt = cp->c_idle;
+	cp->c_idle = sp;
+	pthread_mutex_unlock(&cachelock);
+}
+
+static void oflush(struct gd_out *op)
+{
+	if (op->o_n && op->o_err == 0 &&
+			gd_write(op->o_fd, op->o_buf, op->o_n) < 0)
+		op->o_err = errno;
+	op->o_n = 0;
+}
+
+static void oput(struct gd_out *op, const char *s, size_t n)
+{
+	size_t m;
+
+	while (n) {
+		if (op->o_n == sizeof op->o_buf)
+			oflush(op);
+		m = sizeof op->o_buf - op->o_n;
+		if (m > n)
+			m = n;
+		memcpy(&op->o_buf[op->o_n], s, m);
+		op->o_n += m;
+		s += m;
+		n -= m;
+	}
+}
+
+/*
+ * Print a selected line the way report() in grep.c does.
+ */
+static int gd_hit(void *arg, const char *line, size_t len, long long lineno,
+		long long offset)
+{
+	struct gd_job *jp = arg;
+	struct gd_out *op = jp->j_out;
+	char num[32];
+
+	if (jp->j_mode & GD_QUIET)
+		return 1;
+	if (jp->j_mode & GD_LIST) {
+		oput(op, jp->j_name ? jp->j_name : stdinmsg,
+			strlen(jp->j_name ? jp->j_name : stdinmsg));
+		oput(op, "\n", 1);
+		return 1;
+	}
+	if (jp->j_mode & GD_COUNT)
+		return 0;
+	if (jp->j_mode & GD_NAME && jp->j_name) {
+		oput(op, jp->j_name, strlen(jp->j_name));
+		oput(op, ":", 1);
+	}
+	if (jp->j_mode & GD_BLOCK)
+		oput(op, num, sprintf(num, "%llu:",
+			(unsigned long long)offset / BSZ));
+	if (jp->j_mode & GD_NUM)
+		oput(op, num, sprintf(num, "%llu:", (unsigned long long)lineno));
+	oput(op, line, len);
+	oput(op, "\n", 1);
+	return op->o_err != 0;
+}
+
+static int gd_reply(int s, long long count, int err, const char *msg)
+{
+	struct gd_rep rp;
+
+	memset(&rp, 0, sizeof rp);
+	rp.p_count = count;
+	rp.p_err = err;
+	rp.p_msglen = msg ? strlen(msg) : 0;
+	if (gd_write(s, &rp, sizeof rp) < 0 ||
+			(msg && gd_write(s, msg, rp.p_msglen) < 0))
+		return -1;
+	return 0;
+}
+
+/*
+ * Serve one client.
+ */
+static void *gd_serve(void *arg)
+{
+	int s = (int)(long)arg, ofd = -1, fd, err;
+	struct gd_req rq;
+	struct gd_file fr;
+	struct gd_job job;
+	struct gd_out *op = NULL;
+	struct gd_pat *cp = NULL;
+	grep_scan *sc = NULL;
+	char *pats = NULL, *name = NULL, msg[256], num[32];
+	long long n;
+
+	if (gd_recvfd(s, &rq, sizeof rq, &ofd) != 1 || ofd < 0 ||
+			rq.r_magic != GD_MAGIC)
+		goto done;
+	if (rq.r_patlen > GD_MAXPAT) {
+		gd_reply(s, 0, E2BIG, "patterns too long");
+		goto done;
+	}
+	if ((pats = malloc(rq.r_patlen + 1)) == NULL) {
+		gd_reply(s, 0, ENOMEM, strerror(ENOMEM));
+		goto done;
+	}
+	if (rq.r_patlen && gd_read(s, pats, rq.r_patlen) != 1)
+		goto done;
+	if ((cp = gd_get(pats, rq.r_patlen, rq.r_flags, &err)) == NULL) {
+		grep_error(err, msg, sizeof msg);
+		gd_reply(s, 0, err, msg);
+		goto done;
+	}
+	if ((sc = gd_scan(cp)) == NULL) {
+		gd_reply(s, 0, errno, strerror(errno));
+		goto done;
+	}
+	if (gd_reply(s, 0, 0, NULL) < 0)
+		goto done;
+	op = smalloc(sizeof *op);
+	op->o_fd = ofd;
+	op->o_err = 0;
+	op->o_n = 0;
+	job.j_out = op;
+	job.j_mode = rq.r_out;
+	while (gd_recvfd(s, &fr, sizeof fr, &fd) == 1) {
+		if (fr.f_namelen > PATH_MAX) {
+			if (fd >= 0)
+				close(fd);
+			break;
+		}
+		name = srealloc(name, fr.f_namelen + 1);
+		if (fr.f_namelen && gd_read(s, name, fr.f_namelen) != 1) {
+			if (fd >= 0)
+				close(fd);
+			break;
+		}
+		name[fr.f_namelen] = '\0';
+		job.j_name = fr.f_namelen ? name : NULL;
+		if (fd < 0) {
+			n = -1;
+			errno = EBADF;
+		} else {
+			n = grep_fd(sc, fd, gd_hit, &job);
+			err = errno;
+			close(fd);
+			errno = err;
+		}
+		err = n < 0 ? errno : 0;
+		if (n >= 0 && (rq.r_out & (GD_COUNT|GD_QUIET)) == GD_COUNT) {
+			if (rq.r_out & GD_NAME && job.j_name) {
+				oput(op, name, fr.f_namelen);
+				oput(op, ":", 1);
+			}
+			oput(op, num, sprintf(num, "%llu\n", (unsigned long long)n));
+		}
+		oflush(op);
+		if (op->o_err || gd_reply(s, n, err, NULL) < 0)
+			break;
+	}
+done:
+	if (sc)
+		gd_unscan(cp, sc);
+	if (cp)
+		gd_put(cp);
+	if (ofd >= 0)
+		close(ofd);
+	close(s);
+	free(op);
+	free(pats);
+	free(name);
+	return NULL;
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: %s [socket]\n", progname);
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	struct sockaddr_un sa;
+	pthread_attr_t attr;
+	pthread_t t;
+	char *path;
+	int s, c;
+
+	progname = basename(argv[0]);
+	setlocale(LC_COLLATE, "");
+	setlocale(LC_CTYPE, "");
+	if (argc > 2 || (argc == 2 && argv[1][0] == '-'))
+		usage();
+	if (argc == 2)
+		path = argv[1];
+	else if (gd_path(&path, 1) < 0) {
+		fprintf(stderr, "%s: cannot use %s: %s\n", progname, path,
+			strerror(errno));
+		exit(2);
+	}
+	if (strlen(path) >= sizeof sa.sun_path) {
+		fprintf(stderr, "%s: socket name too long: %s\n", progname, path);
+		exit(2);
+	}
+	memset(&sa, 0, sizeof sa);
+	sa.sun_family = AF_UNIX;
+	strcpy(sa.sun_path, path);
+	if ((s = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+		fprintf(stderr, "%s: socket: %s\n", progname, strerror(errno));
+		exit(2);
+	}
+	unlink(path);
+	umask(077);
+	if (bind(s, (struct sockaddr *)&sa, sizeof sa) < 0 || listen(s, 64) < 0) {
+		fprintf(stderr, "%s: cannot listen on %s: %s\n", progname, path,
+			strerror(errno));
+		exit(2);
+	}
+	signal(SIGPIPE, SIG_IGN);
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	for (;;) {
+		if ((c = accept(s, NULL, NULL)) < 0) {
+			/*
+			 * Only a broken socket is for good; when out of
+			 * descriptors or memory, wait for clients to
+			 * finish.
+			 */
+			if (errno == EBADF || errno == EINVAL ||
+					errno == ENOTSOCK) {
+				fprintf(stderr, "%s: accept: %s\n", progname,
+					strerror(errno));
+				exit(2);
+			}
+			if (errno != EINTR && errno != ECONNABORTED)
+				sleep(1);
+			continue;
+		}
+		if (pthread_create(&t, &attr, gd_serve, (void *)(long)c) != 0)
+			close(c);
+	}
+}
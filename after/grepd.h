@@ -0,0 +1,90 @@
+/*
+ * grep - search a file for a pattern
+ *
+ * Gunnar Ritter, Freiburg i. Br., Germany, April 2001.
+ */
+/*
+ * Copyright (c) 2003 Gunnar Ritter
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute
+ * it freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+/*
+ * Protocol between grepd, the search server, and grepc, its client.
+ *
+ * The client connects to the Unix socket of the server and sends a
+ * struct gd_req, followed by r_patlen bytes of newline-separated
+ * patterns, with its standard output passed along as the only file
+ * descriptor. The server answers with a struct gd_rep, followed by
+ * p_msglen bytes of error message if the patterns were not accepted.
+ * Then, for each file, the client sends a struct gd_file followed by
+ * the name, with the open file passed along, and the server answers
+ * with a struct gd_rep once the output for the file is written. A
+ * name of length 0 stands for standard input. The client ends the
+ * session by shutting down its side of the connection.
+ *
+ * The client passes its output and its files to whoever listens on the
+ * socket, so the socket is kept in a directory only the user can get
+ * at, and the client makes sure that the server runs as the same user.
+ */
+#ifndef GREPD_H_
+#define GREPD_H_
+
+#include <sys/types.h>
+
+#define GD_MAGIC 0x67726431 /* "grd1" */
+#define GD_MAXPAT (64 * 1024 * 1024) /* longest pattern list accepted */
+
+/*
+ * Output flags.
+ */
+enum gdout {
+	GD_COUNT = 01, /* print count only, as -c */
+	GD_LIST = 02,  /* print file names only, as -l */
+	GD_QUIET = 04, /* no output at all, as -q */
+	GD_NUM = 010,  /* print line numbers, as -n */
+	GD_BLOCK = 020, /* print block numbers, as -b */
+	GD_NAME = 040  /* prefix lines with file names */
+};
+
+struct gd_req {
+	unsigned int r_magic;
+	int r_flags;		/* GREP_* of public.h */
+	int r_out;		/* enum gdout */
+	unsigned int r_patlen;
+};
+
+struct gd_file {
+	unsigned int f_namelen;
+};
+
+struct gd_rep {
+	long long p_count;	/* selected lines */
+	int p_err;		/* errno, or compile error */
+	unsigned int p_msglen;
+};
+
+extern int gd_sendfd(int, const void *, size_t, int);
+extern int gd_recvfd(int, void *, size_t, int *);
+extern int gd_read(int, void *, size_t);
+extern int gd_write(int, const void *, size_t);
+extern int gd_path(char **, int);
+extern int gd_peeruid(int, uid_t *);
+
+#endif
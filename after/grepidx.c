@@ -0,0 +1,286 @@
+/*
+ * grep - search a file for a pattern
+ *
+ * Gunnar Ritter, Freiburg i. Br., Germany, April 2001.
+ */
+/*
+ * Copyright (c) 2003 Gunnar Ritter
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute
+ * it freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+/*
+ * grepidx - build a trigram index for grep
+ */
+
+#include "alloc.h"
+#include "trigram.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+static char *progname;
+static int status;
+
+static struct ixfile *files;
+static unsigned int nfile, maxfile;
+static char *names;
+static unsigned long long strsz, maxstr;
+
+/*
+ * (trigram << 32 | file) for each trigram of each file.
+ */
+static unsigned long long *pairs;
+static size_t npair, maxpair;
+
+static unsigned char *seen;	/* trigrams in the current file, by bit */
+static unsigned int *fresh;	/* the same, as a list */
+static size_t nfresh, maxfresh;
+
+static void addname(const char *fn, struct stat *sp)
+{
+	size_t n = strlen(fn) + 1;
+
+	if (nfile == maxfile)
+		files = srealloc(files, (maxfile = maxfile ? 2 * maxfile : 1024) *
+				sizeof *files);
+	while (strsz + n > maxstr)
+		names = srealloc(names, maxstr = maxstr ? 2 * maxstr : 65536);
+	memcpy(&names[strsz], fn, n);
+	files[nfile].f_name = strsz;
+	files[nfile].f_mtime = sp->st_mtime;
+	files[nfile].f_size = sp->st_size;
+	strsz += n;
+}
+
+static void addtri(unsigned int t)
+{
+	if (seen[t >> 3] & 1 << (t & 7))
+		return;
+	seen[t >> 3] |= 1 << (t & 7);
+	if (nfresh == maxfresh)
+		fresh = srealloc(fresh, (maxfresh = maxfresh ? 2 * maxfresh : 4096) *
+				sizeof *fresh);
+	fresh[nfresh++] = t;
+}
+
+/*
+ * Enter the trigrams of a regular file.
+ */
+static void indexfile(const char *fn)
+{
+	static char *buf;
+	struct stat st;
+	unsigned int a = 0, b = 0, c;
+	ssize_t n, i;
+	size_t k, got = 0;
+	int fd;
+
+	if ((fd = open(fn, O_RDONLY)) < 0 || fstat(fd, &st) < 0) {
+		fprintf(stderr, "%s: can't open %s\n", progname, fn);
+		if (fd >= 0)
+			close(fd);
+		status = 2;
+		return;
+	}
+	if (buf == NULL)
+		buf = smalloc(65536);
+	nfresh = 0;
+	while ((n = read(fd, buf, 65536)) > 0) {
+		for (i = 0; i < n; i++, got++) {
+			c = buf[i] & 0377;
+			if (got >= 2)
+				addtri(TRI(a, b, c));
+			a = b;
+			b = c;
+		}
+	}
+	close(fd);
+	if (n < 0) {
+		fprintf(stderr, "%s: read error on %s: %s\n", progname, fn,
+			strerror(errno));
+		status = 2;
+	} else {
+		addname(fn, &st);
+		if (npair + nfresh > maxpair) {
+			while (npair + nfresh > maxpair)
+				maxpair = maxpair ? 2 * maxpair : 65536;
+			pairs = srealloc(pairs, maxpair * sizeof *pairs);
+		}
+		for (k = 0; k < nfresh; k++)
+			pairs[npair++] = (unsigned long long)fresh[k] << 32 | nfile;
+		nfile++;
+	}
+	for (k = 0; k < nfresh; k++)
+		seen[fresh[k] >> 3] = 0;
+}
+
+/*
+ * Walk a file tree the way grep -r does, building the same names.
+ */
+static void walk(const char *fn, int level)
+{
+	struct stat st;
+	struct dirent *dp;
+	DIR *df;
+	char *path;
+	size_t n;
+
+	if ((level ? lstat : stat)(fn, &st) < 0) {
+		fprintf(stderr, "%s: can't open %s\n", progname, fn);
+		status = 2;
+		return;
+	}
+	if (S_ISREG(st.st_mode)) {
+		indexfile(fn);
+		return;
+	}
+	if (!S_ISDIR(st.st_mode))
+		return;
+	if ((df = opendir(fn)) == NULL) {
+		fprintf(stderr, "%s: can't open directory %s\n", progname, fn);
+		status = 2;
+		return;
+	}
+	n = strlen(fn);
+	while ((dp = readdir(df)) != NULL) {
+		if (dp->d_name[0] == '.' && (dp->d_name[1] == '\0' ||
+				(dp->d_name[1] == '.' && dp->d_name[2] == '\0')))
+			continue;
+		path = smalloc(n + strlen(dp->d_name) + 2);
+		memcpy(path, fn, n);
+		path[n] = '/';
+		strcpy(&path[n + 1], dp->d_name);
+		walk(path, level + 1);
+		free(path);
+	}
+	closedir(df);
+}
+
+static int paircmp(const void *a, const void *b)
+{
+	unsigned long long x = *(const unsigned long long *)a;
+	unsigned long long y = *(const unsigned long long *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static int namecmp(const void *a, const void *b)
+{
+	return strcmp(&names[files[*(const unsigned int *)a].f_name],
+		&names[files[*(const unsigned int *)b].f_name]);
+}
+
+static void writeidx(const char *out)
+{
+	struct ixhdr h;
+	struct ixtri t;
+	unsigned int *byname, *post, i;
+	size_t j, k;
+	char *tmp;
+	FILE *fp;
+
+	qsort(pairs, npair, sizeof *pairs, paircmp);
+	byname = smalloc((nfile + 1) * sizeof *byname);
+	for (i = 0; i < nfile; i++)
+		byname[i] = i;
+	qsort(byname, nfile, sizeof *byname, namecmp);
+	tmp = smalloc(strlen(out) + 24);
+	sprintf(tmp, "%s.%ld", out, (long)getpid());
+	if ((fp = fopen(tmp, "w")) == NULL) {
+		fprintf(stderr, "%s: can't create %s\n", progname, tmp);
+		exit(2);
+	}
+	memset(&h, 0, sizeof h);
+	memcpy(h.h_magic, IXMAGIC, sizeof h.h_magic);
+	h.h_nfile = nfile;
+	for (j = 0; j < npair; j++)
+		if (j == 0 || pairs[j] >> 32 != pairs[j - 1] >> 32)
+			h.h_ntri++;
+	h.h_strsz = strsz;
+	h.h_npost = npair;
+	fwrite(&h, sizeof h, 1, fp);
+	fwrite(files, sizeof *files, nfile, fp);
+	fwrite(byname, sizeof *byname, nfile, fp);
+	for (j = 0; j < npair; j = k) {
+		for (k = j; k < npair && pairs[k] >> 32 == pairs[j] >> 32; k++)
+			;
+		t.t_tri = pairs[j] >> 32;
+		t.t_cnt = k - j;
+		t.t_post = j;
+		fwrite(&t, sizeof t, 1, fp);
+	}
+	fwrite(names, 1, strsz, fp);
+	/*
+	 * The file numbers are the low halves of the sorted pairs.
+	 */
+	post = smalloc(4096 * sizeof *post);
+	for (j = 0; j < npair; j += k) {
+		for (k = 0; k < 4096 && j + k < npair; k++)
+			post[k] = pairs[j + k] & 0xffffffff;
+		fwrite(post, sizeof *post, k, fp);
+	}
+	free(post);
+	if (fclose(fp) != 0 || rename(tmp, out) != 0) {
+		fprintf(stderr, "%s: can't write %s: %s\n", progname, out,
+			strerror(errno));
+		unlink(tmp);
+		exit(2);
+	}
+	free(tmp);
+	free(byname);
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: %s [-o index] file ...\n", progname);
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	char *out;
+	int c;
+
+	progname = basename(argv[0]);
+	out = getenv("GREP_INDEX");
+	while ((c = getopt(argc, argv, "o:")) != EOF) {
+		switch (c) {
+		case 'o':
+			out = optarg;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind == argc || out == NULL || *out == '\0')
+		usage();
+	seen = scalloc(1 << 21, 1);
+	while (optind < argc)
+		walk(argv[optind++], 0);
+	writeidx(out);
+	return status;
+}
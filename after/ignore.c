@@ -0,0 +1,281 @@
+/*
+ * grep - search a file for a pattern
+ *
+ * Gunnar Ritter, Freiburg i. Br., Germany, April 2001.
+ */
+/*
+ * Copyright (c) 2003 Gunnar Ritter
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute
+ * it freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+/*
+ * Ignore files (--ignore-file), in the manner of .gitignore.
+ *
+ * Each directory descended by -r or -R that has an ignore file gets a
+ * frame on a stack, holding the rules read from it. A name is checked
+ * against the frames from the innermost directory outwards, and within
+ * a frame against its rules from the last one backwards; the first rule
+ * that matches decides. An ignored directory is not descended at all,
+ * so nothing below it is read.
+ *
+ * Rules are shell patterns, as for gmatch(). Those without a '/' match
+ * the last component of a name in the directory of the ignore file or
+ * below it; those with one match the name relative to that directory,
+ * with '*', '?', and '[' not matching a '/', and "**" matching any
+ * number of components. A trailing '/' makes a rule match directories
+ * only, and a leading '!' makes it take a name back in. Since only a
+ * frame with such negated rules depends on their order, the plain name
+ * rules of the others go into name lists, matched with one lookup.
+ */
+
+#include "alloc.h"
+#include "grep.h"
+#include <stdlib.h>
+#include <string.h>
+
+extern int gmatch(const char *, const char *);
+
+enum igflags {
+	IG_NEG = 01,	/* '!': take the name back in */
+	IG_DIR = 02,	/* trailing '/': directories only */
+	IG_PATH = 04	/* has a '/': match the relative name */
+};
+
+struct igrule {
+	char *r_pat;
+	enum igflags r_flags;
+};
+
+struct igframe {
+	struct igframe *f_up;	/* frame of the directory above */
+	size_t f_plen;		/* length of the directory name and '/' */
+	struct igrule *f_rule;	/* rules in order, or path rules only */
+	int f_nrule;
+	int f_neg;		/* has negated rules */
+	struct nmlist f_any;	/* name rules without f_neg */
+	struct nmlist f_dir;	/* the same, directories only */
+};
+
+int igon;			/* ignore files are read */
+static char **ignames;		/* names of ignore files */
+static int nignames;
+static struct igframe *top;	/* innermost frame */
+
+/*
+ * Read ignore files with this name.
+ */
+void ig_name(const char *name)
+{
+	ignames = srealloc(ignames, (nignames + 1) * sizeof *ignames);
+	ignames[nignames] = smalloc(strlen(name) + 1);
+	strcpy(ignames[nignames++], name);
+	igon = 1;
+}
+
+/*
+ * Turn a line of an ignore file into a rule in the frame. The rules
+ * are kept in order until the whole file has been read.
+ */
+static void ig_rule(struct igframe *fp, char *s, size_t n)
+{
+	struct igrule *rp;
+	enum igflags fl = 0;
+
+	while (n > 0 && (s[n-1] == '\n' || s[n-1] == '\r'))
+		n--;
+	while (n > 0 && s[n-1] == ' ' && (n < 2 || s[n-2] != '\\'))
+		n--;
+	s[n] = '\0';
+	if (n == 0 || s[0] == '#')
+		return;
+	if (s[0] == '!') {
+		fl |= IG_NEG;
+		s++, n--;
+	} else if (s[0] == '\\' && (s[1] == '!' || s[1] == '#'))
+		s++, n--;
+	if (n > 0 && s[n-1] == '/') {
+		fl |= IG_DIR;
+		s[--n] = '\0';
+	}
+	if (n == 0)
+		return;
+	if (strchr(s, '/')) {
+		fl |= IG_PATH;
+		if (s[0] == '/')
+			s++, n--;
+	}
+	fp->f_rule = srealloc(fp->f_rule, (fp->f_nrule + 1) *
+			sizeof *fp->f_rule);
+	rp = &fp->f_rule[fp->f_nrule++];
+	rp->r_pat = smalloc(n + 1);
+	strcpy(rp->r_pat, s);
+	rp->r_flags = fl;
+	if (fl & IG_NEG)
+		fp->f_neg = 1;
+}
+
+/*
+ * Read the ignore files in the directory fn, whose entries are named
+ * with plen bytes of the directory name and '/' before them. Returns
+ * 1 if a frame was pushed, to be taken off with ig_pop().
+ */
+int ig_push(const char *fn, size_t plen)
+{
+	struct igframe *fp;
+	struct iblok *ip;
+	char *path, *line = NULL;
+	size_t size = 0, n;
+	int i, j, k;
+
+	fp = scalloc(1, sizeof *fp);
+	for (i = 0; i < nignames; i++) {
+		path = smalloc(strlen(fn) + strlen(ignames[i]) + 2);
+		strcpy(path, fn);
+		strcat(path, "/");
+		strcat(path, ignames[i]);
+		if ((ip = ib_open(path, 0)) != NULL) {
+			while ((n = ib_getlin(ip, &line, &size, srealloc)) != 0)
+				ig_rule(fp, line, n);
+			ib_close(ip);
+		}
+		free(path);
+	}
+	free(line);
+	if (fp->f_nrule == 0) {
+		free(fp);
+		return 0;
+	}
+	if (fp->f_neg == 0) {
+		for (j = k = 0; j < fp->f_nrule; j++)
+			if (fp->f_rule[j].r_flags & IG_PATH)
+				fp->f_rule[k++] = fp->f_rule[j];
+			else {
+				nm_add(fp->f_rule[j].r_flags & IG_DIR ?
+						&fp->f_dir : &fp->f_any,
+						fp->f_rule[j].r_pat);
+				free(fp->f_rule[j].r_pat);
+			}
+		fp->f_nrule = k;
+	}
+	fp->f_plen = plen;
+	fp->f_up = top;
+	top = fp;
+	return 1;
+}
+
+void ig_pop(void)
+{
+	struct igframe *fp = top;
+	int i;
+
+	top = fp->f_up;
+	for (i = 0; i < fp->f_nrule; i++)
+		free(fp->f_rule[i].r_pat);
+	free(fp->f_rule);
+	nm_free(&fp->f_any);
+	nm_free(&fp->f_dir);
+	free(fp);
+}
+
+/*
+ * Copy the component of s up to a '/' into a scratch buffer.
+ */
+static void ig_comp(char **buf, size_t *size, const char *s,
+		const char **end)
+{
+	size_t n;
+
+	*end = strchr(s, '/');
+	n = *end ? (size_t)(*end - s) : strlen(s);
+	if (n + 1 > *size)
+		*buf = srealloc(*buf, *size = n + 1);
+	memcpy(*buf, s, n);
+	(*buf)[n] = '\0';
+}
+
+/*
+ * Match a relative name against a rule with a '/', one component at
+ * a time.
+ */
+static int ig_path(const char *p, const char *s)
+{
+	static char *pb, *sb;
+	static size_t pz, sz;
+	const char *pe, *se;
+
+	if (p[0] == '*' && p[1] == '*' && (p[2] == '/' || p[2] == '\0')) {
+		if (p[2] == '\0')
+			return 1;
+		for (;;) {
+			if (ig_path(&p[3], s))
+				return 1;
+			if ((s = strchr(s, '/')) == NULL)
+				return 0;
+			s++;
+		}
+	}
+	ig_comp(&pb, &pz, p, &pe);
+	ig_comp(&sb, &sz, s, &se);
+	if (!gmatch(sb, pb))
+		return 0;
+	if (pe == NULL || se == NULL)
+		return pe == NULL && se == NULL;
+	return ig_path(&pe[1], &se[1]);
+}
+
+static int ig_match(const struct igrule *rp, const char *rel,
+		const char *name, int dir)
+{
+	if ((rp->r_flags & IG_DIR) && !dir)
+		return 0;
+	if (rp->r_flags & IG_PATH)
+		return ig_path(rp->r_pat, rel);
+	return gmatch(name, rp->r_pat);
+}
+
+/*
+ * Is the file or directory at path, whose last component is name, to
+ * be ignored?
+ */
+int ig_skip(const char *path, const char *name, int dir)
+{
+	struct igframe *fp;
+	const char *rel;
+	int i;
+
+	for (fp = top; fp; fp = fp->f_up) {
+		rel = &path[fp->f_plen];
+		if (fp->f_neg) {
+			for (i = fp->f_nrule - 1; i >= 0; i--)
+				if (ig_match(&fp->f_rule[i], rel, name, dir))
+					return !(fp->f_rule[i].r_flags &
+							IG_NEG);
+			continue;
+		}
+		if ((fp->f_any.l_any && nm_match(&fp->f_any, name)) ||
+				(dir && fp->f_dir.l_any &&
+				 nm_match(&fp->f_dir, name)))
+			return 1;
+		for (i = 0; i < fp->f_nrule; i++)
+			if (ig_match(&fp->f_rule[i], rel, name, dir))
+				return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,366 @@
+/*
+ * grep - search a file for a pattern
+ *
+ * Gunnar Ritter, Freiburg i. Br., Germany, April 2001.
+ */
+/*
+ * Copyright (c) 2003 Gunnar Ritter
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute
+ * it freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+/*
+ * Search library. Unlike the commands, which keep their options and
+ * the compiled patterns in global variables, everything here hangs off
+ * the pattern and scanner handles, and errors are returned instead of
+ * ending the process; only running out of memory is still fatal, as
+ * with smalloc() everywhere. The matchers are those of new grep: the
+ * Aho-Corasick automaton of ac.c for fixed strings, and regcomp() of
+ * libuxre otherwise. The compiled automaton is only read while lines
+ * are checked and is shared by all scanners; a regex_t is not (the
+ * lazy DFA fills in its states during regexec()), so every scanner
+ * compiles one of its own.
+ *
+ * Link with -lgrep -luxre.
+ */
+
+#include "alloc.h"
+#include "grep.h"
+#include "public.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+struct grep_pat {
+	int p_flags;		/* GREP_* */
+	int p_all;		/* every line matches */
+	int p_empty;		/* an empty pattern was given */
+	struct acaut *p_ac;	/* automaton for fixed strings */
+	char *p_re;		/* or pattern for regcomp() */
+	int p_rflags;
+};
+
+struct grep_scan {
+	const grep_pat *s_pat;
+	regex_t s_re;
+	int s_hasre;
+	char *s_line;		/* copy of the line for regexec() */
+	size_t s_lsize;
+	char *s_buf;		/* input read by grep_fd() */
+	size_t s_bsize;
+	long long s_lineno;
+	long long s_offset;
+	long long s_count;
+	int s_stop;
+};
+
+/*
+ * Split the patterns at newlines; as in a pattern file, a final
+ * newline does not start another pattern. With -w, an empty expression
+ * becomes \<\> and is not counted as empty.
+ */
+static struct expr *gl_split(const char *pats, size_t len, int flags,
+		int *nempty)
+{
+	struct expr *e0 = NULL, **ep = &e0, *e;
+	const char *cp, *end = &pats[len];
+
+	*nempty = 0;
+	do {
+		if ((cp = memchr(pats, '\n', end - pats)) == NULL)
+			cp = end;
+		e = scalloc(1, sizeof *e);
+		e->e_pat = (char *)pats;
+		e->e_len = cp - pats;
+		if (e->e_len == 0 &&
+				(flags & (GREP_WORD|GREP_FIXED)) != GREP_WORD)
+			(*nempty)++;
+		*ep = e;
+		ep = &e->e_nxt;
+		pats = cp + 1;
+	} while (cp < end && pats < end);
+	for (e = e0; e->e_nxt; e = e->e_nxt)
+		e->e_flg = E_NL;
+	return e0;
+}
+
+static void gl_efree(struct expr *e)
+{
+	struct expr *en;
+
+	for (; e; e = en) {
+		en = e->e_nxt;
+		free(e);
+	}
+}
+
+/*
+ * Join the patterns for REG_NLALT, leaving out empty ones, or with -w
+ * surrounding each by \< \> as wcomp() does.
+ */
+static char *gl_join(struct expr *e0, int flags)
+{
+	struct expr *e;
+	char *pat, *cp;
+	size_t sz;
+	long n;
+
+	for (sz = 1, e = e0; e; e = e->e_nxt)
+		sz += e->e_len + 8;
+	cp = pat = smalloc(sz);
+	for (e = e0; e; e = e->e_nxt) {
+		if ((n = e->e_len) == 0 && (flags & GREP_WORD) == 0)
+			continue;
+		if (cp > pat)
+			*cp++ = '\n';
+		if ((flags & GREP_WORD) == 0) {
+			memcpy(cp, e->e_pat, n);
+			cp += n;
+		} else if (flags & GREP_EXTENDED && n > 0) {
+			memcpy(cp, "\\<(", 3);
+			memcpy(&cp[3], e->e_pat, n);
+			memcpy(&cp[3 + n], ")\\>", 3);
+			cp += n + 6;
+		} else
+			cp += gl_wrap(cp, e->e_pat, n);
+	}
+	*cp = '\0';
+	return pat;
+}
+
+/*
+ * Compile the newline-separated patterns in pats. On failure, NULL is
+ * returned and *errp is set to an error code for grep_error().
+ */
+grep_pat *grep_comp(const char *pats, size_t len, int flags, int *errp)
+{
+	grep_pat *p;
+	struct expr *e0, *e;
+	regex_t re;
+	int nempty, n, err = 0, aflags;
+
+	p = scalloc(1, sizeof *p);
+	p->p_flags = flags;
+	e0 = gl_split(pats, len, flags, &nempty);
+	for (n = 0, e = e0; e; e = e->e_nxt)
+		n++;
+	p->p_empty = nempty > 0;
+	if (nempty && (flags & GREP_LINE) == 0)
+		p->p_all = 1;
+	else if (flags & GREP_FIXED || (nempty == 0 && gl_fixedset(e0, flags))) {
+		aflags = (flags & GREP_ICASE ? AC_ICASE|AC_FOLD : 0) |
+			(flags & GREP_LINE ? AC_LINE : 0) |
+			(flags & GREP_WORD ? AC_WORD : 0) |
+			(flags & GREP_FIXED ? 0 : AC_NULEOL) |
+			(MB_CUR_MAX > 1 ? AC_MB : 0);
+		p->p_ac = ac_comp(e0, aflags, &err);
+	} else if (nempty < n) {
+		p->p_re = gl_join(e0, flags);
+		if (flags & GREP_EXTENDED)
+			p->p_rflags = REG_EXTENDED | REG_MTPARENBAD |
+				(flags & GREP_WORD ? REG_ANGLES : 0);
+		else
+			p->p_rflags = REG_ANGLES;
+		if (flags & GREP_ICASE)
+			p->p_rflags |= REG_ICASE;
+		p->p_rflags |= flags & GREP_LINE ? REG_ONESUB : REG_NOSUB;
+		if (n - nempty > 1)
+			p->p_rflags |= REG_NLALT;
+		if ((err = regcomp(&re, p->p_re, p->p_rflags)) == 0)
+			regfree(&re);
+	}
+	gl_efree(e0);
+	if (err) {
+		grep_free(p);
+		*errp = err;
+		return NULL;
+	}
+	return p;
+}
+
+size_t grep_error(int err, char *buf, size_t size)
+{
+	return regerror(err, NULL, buf, size);
+}
+
+void grep_free(grep_pat *p)
+{
+	if (p == NULL)
+		return;
+	ac_free(p->p_ac);
+	free(p->p_re);
+	free(p);
+}
+
+/*
+ * Get a scanner for p, which must stay around while it is used. NULL
+ * is returned if the expression cannot be compiled again.
+ */
+grep_scan *grep_scan_new(const grep_pat *p)
+{
+	grep_scan *s;
+	int err;
+
+	s = scalloc(1, sizeof *s);
+	s->s_pat = p;
+	if (p->p_re) {
+		if ((err = regcomp(&s->s_re, p->p_re, p->p_rflags)) != 0) {
+			free(s);
+			errno = err == REG_ESPACE ? ENOMEM : EINVAL;
+			return NULL;
+		}
+		s->s_hasre = 1;
+	}
+	return s;
+}
+
+void grep_scan_free(grep_scan *s)
+{
+	if (s == NULL)
+		return;
+	if (s->s_hasre)
+		regfree(&s->s_re);
+	free(s->s_line);
+	free(s->s_buf);
+	free(s);
+}
+
+static int gl_match(grep_scan *s, const char *line, size_t len)
+{
+	const grep_pat *p = s->s_pat;
+	regmatch_t pm[1];
+
+	if (p->p_all || (p->p_empty && len == 0))
+		return 1;
+	if (p->p_ac)
+		return ac_exec(p->p_ac, line, len);
+	if (s->s_hasre == 0)
+		return 0;
+	if (len >= s->s_lsize) {
+		s->s_lsize = len + 1 > 2 * s->s_lsize ? len + 1 : 2 * s->s_lsize;
+		free(s->s_line);
+		s->s_line = smalloc(s->s_lsize);
+	}
+	memcpy(s->s_line, line, len);
+	s->s_line[len] = '\0';
+	if (regexec(&s->s_re, s->s_line, 1, pm, 0) != 0)
+		return 0;
+	return (p->p_flags & GREP_LINE) == 0 ||
+		(pm[0].rm_so == 0 && pm[0].rm_eo >= 0 &&
+		 (size_t)pm[0].rm_eo == len);
+}
+
+/*
+ * Check the lines in buf; the last one need not end with a newline.
+ * Line numbers and offsets continue from the previous call.
+ */
+static void gl_lines(grep_scan *s, const char *buf, size_t sz,
+		grep_hit fn, void *arg)
+{
+	const char *cp, *end = &buf[sz];
+	size_t len;
+	int inv = (s->s_pat->p_flags & GREP_INVERT) != 0;
+
+	while (buf < end && s->s_stop == 0) {
+		if ((cp = memchr(buf, '\n', end - buf)) == NULL)
+			cp = end;
+		len = cp - buf;
+		s->s_lineno++;
+		if (gl_match(s, buf, len) != inv) {
+			s->s_count++;
+			if (fn && fn(arg, buf, len, s->s_lineno, s->s_offset))
+				s->s_stop = 1;
+		}
+		s->s_offset += len + (cp < end);
+		buf = cp + 1;
+	}
+}
+
+static void gl_start(grep_scan *s)
+{
+	s->s_lineno = s->s_offset = s->s_count = 0;
+	s->s_stop = 0;
+}
+
+/*
+ * Search the size bytes at buf; return the number of lines selected.
+ */
+long long grep_buf(grep_scan *s, const char *buf, size_t size, grep_hit fn,
+		void *arg)
+{
+	gl_start(s);
+	gl_lines(s, buf, size, fn, arg);
+	return s->s_count;
+}
+
+/*
+ * Search the input from fd; return the number of lines selected, or
+ * -1 with errno set if it cannot be read.
+ */
+long long grep_fd(grep_scan *s, int fd, grep_hit fn, void *arg)
+{
+	size_t have = 0, done;
+	ssize_t n;
+	char *cp;
+
+	gl_start(s);
+	if (s->s_buf == NULL)
+		s->s_buf = smalloc(s->s_bsize = 65536);
+	for (;;) {
+		if (have == s->s_bsize)
+			s->s_buf = srealloc(s->s_buf, s->s_bsize *= 2);
+		if ((n = read(fd, &s->s_buf[have], s->s_bsize - have)) < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		if (n == 0)
+			break;
+		have += n;
+		for (cp = &s->s_buf[have]; cp > &s->s_buf[have - n]; cp--)
+			if (cp[-1] == '\n')
+				break;
+		if (cp == &s->s_buf[have - n])
+			continue;
+		done = cp - s->s_buf;
+		gl_lines(s, s->s_buf, done, fn, arg);
+		if (s->s_stop)
+			return s->s_count;
+		memmove(s->s_buf, cp, have -= done);
+	}
+	if (have)
+		gl_lines(s, s->s_buf, have, fn, arg);
+	return s->s_count;
+}
+
+long long grep_path(grep_scan *s, const char *path, grep_hit fn, void *arg)
+{
+	long long n;
+	int fd, err;
+
+	if ((fd = open(path, O_RDONLY)) < 0)
+		return -1;
+	n = grep_fd(s, fd, fn, arg);
+	err = errno;
+	close(fd);
+	errno = err;
+	return n;
+}
@@ -117,6 +117,8 @@ typedef union	/* extra info always kept for some tokens/nodes */
 	unsigned short	num[2];	/* ROP_BRACE: num[0]=low, num[1]=high */
 } Info;
 
+typedef struct t_pool	Pool;	/* block of memory handed out in pieces */
+
 typedef struct	/* lexical context while parsing */
 {
 	Info			info;
@@ -132,6 +134,7 @@ typedef struct	/* lexical context while parsing */
 	int			bktflags;
 	int			err;
 	int			mb_cur_max;
+	Pool			*pool;	/* holds the parse tree */
 } Lex;
 
 typedef struct t_tree	Tree;	/* RE parse tree node */
@@ -213,9 +216,12 @@ LIBUXRE_STATIC int	libuxre_bktmbcomp(Bracket *, const unsigned char *,
 LIBUXRE_STATIC int	libuxre_bktmbexec(Bracket *, wchar_t,
 				const unsigned char *, int);
 
+LIBUXRE_STATIC void	*libuxre_palloc(Pool **, size_t);
+LIBUXRE_STATIC void	libuxre_pfree(Pool **);
+
 LIBUXRE_STATIC void	libuxre_regdeltree(Tree *, int);
-LIBUXRE_STATIC Tree	*libuxre_reg1tree(w_type, Tree *);
-LIBUXRE_STATIC Tree	*libuxre_reg2tree(w_type, Tree *, Tree *);
+LIBUXRE_STATIC Tree	*libuxre_reg1tree(Lex *, w_type, Tree *);
+LIBUXRE_STATIC Tree	*libuxre_reg2tree(Lex *, w_type, Tree *, Tree *);
 LIBUXRE_STATIC Tree	*libuxre_regparse(Lex *, const unsigned char *, int);
 
 extern void		libuxre_regdeldfa(Dfa *);
@@ -73,5 +73,85 @@ out:;
 		(void)libuxre_lc_collate(lex.col);
 	if (tp != 0)
 		libuxre_regdeltree(tp, lex.err);
+	libuxre_pfree(&lex.pool);
+	return lex.err;
+}
+
+	/*
+	* Turn the parse tree around for regrevcomp(): concatenations
+	* are reversed, and ^ and $ swap places.  \< and \> are not
+	* handled, since the DFA decides them one character late,
+	* and neither are back-references; -1 is returned for them.
+	*/
+static int
+reverse(Tree *tp)
+{
+	Tree *np;
+
+	switch (tp->op)
+	{
+	case ROP_LT:
+	case ROP_GT:
+	case ROP_REF:
+		return -1;
+	case ROP_BOL:
+		tp->op = ROP_EOL;
+		return 0;
+	case ROP_EOL:
+		tp->op = ROP_BOL;
+		return 0;
+	case ROP_CAT:
+		np = tp->left.ptr;
+		tp->left.ptr = tp->right.ptr;
+		tp->right.ptr = np;
+		/*FALLTHROUGH*/
+	case ROP_OR:
+		if (reverse(tp->right.ptr) != 0)
+			return -1;
+		/*FALLTHROUGH*/
+	case ROP_STAR:
+	case ROP_PLUS:
+	case ROP_QUEST:
+	case ROP_BRACE:
+	case ROP_LP:
+	case ROP_RP:
+		return reverse(tp->left.ptr);
+	default:
+		return 0;
+	}
+}
+
+	/*
+	* Like regcomp(), but build a DFA that matches the reverse of
+	* what pat matches, to be run from the end of a string back to
+	* its start; see rc_span() in grep.  REG_NOSUB is implied.
+	* REG_ENOSYS is returned for patterns that need the NFA.
+	*/
+int
+regrevcomp(regex_t *ep, const char *pat, int flags)
+{
+	Tree *tp;
+	Lex lex;
+
+	flags = (flags & ~REG_ONESUB) | REG_NOSUB;
+	if ((tp=libuxre_regparse(&lex, (const unsigned char *)pat, flags)) == 0)
+		goto out;
+	ep->re_nsub = 0;
+	ep->re_flags = lex.flags & ~(REG_NOTBOL | REG_NOTEOL | REG_NONEMPTY);
+	ep->re_col = lex.col;
+	ep->re_mb_cur_max = lex.mb_cur_max;
+	if (lex.flags & REG_NFA || reverse(tp->left.ptr) != 0)
+		lex.err = REG_ENOSYS;
+	else
+	{
+		ep->re_flags |= REG_DFA;
+		lex.err = libuxre_regdfacomp(ep, tp, &lex);
+	}
+out:;
+	if (lex.err != 0 && lex.col != 0)
+		(void)libuxre_lc_collate(lex.col);
+	if (tp != 0)
+		libuxre_regdeltree(tp, lex.err);
+	libuxre_pfree(&lex.pool);
 	return lex.err;
 }
@@ -41,11 +41,11 @@
 	* share the same pointed to Bracket object).
 	*/
 static Tree *
-copy(regex_t *ep, Tree *tp)
+copy(regex_t *ep, Lex *lxp, Tree *tp)
 {
 	Tree *np;
 
-	if ((np = malloc(sizeof(Tree))) == 0)
+	if ((np = libuxre_palloc(&lxp->pool, sizeof(Tree))) == 0)
 		return 0;
 	switch (np->op = tp->op) /* almost always correct */
 	{
@@ -62,18 +62,15 @@ copy(regex_t *ep, Tree *tp)
 		return np;
 	case ROP_CAT:
 	case ROP_OR:
-		if ((np->right.ptr = copy(ep, tp->right.ptr)) == 0)
-		{
-			free(np);
+		if ((np->right.ptr = copy(ep, lxp, tp->right.ptr)) == 0)
 			return 0;
-		}
 		np->right.ptr->parent = np;
 		/*FALLTHROUGH*/
 	case ROP_STAR:
 	case ROP_PLUS:
 	case ROP_QUEST:
 	case ROP_LP:
-		if ((np->left.ptr = copy(ep, tp->left.ptr)) == 0)
+		if ((np->left.ptr = copy(ep, lxp, tp->left.ptr)) == 0)
 			break;
 		np->left.ptr->parent = np;
 		return np;
@@ -98,8 +95,9 @@ copy(regex_t *ep, Tree *tp)
 	* been applied before any subtrees passed to copy().
 	*/
 static Tree *
-findposn(regex_t *ep, Tree *tp, int mb_cur_max)
+findposn(regex_t *ep, Lex *lxp, Tree *tp)
 {
+	int mb_cur_max = lxp->mb_cur_max; /* for to_upper() */
 	unsigned int lo, hi;
 	Tree *ptr, *par;
 	w_type wc;
@@ -110,13 +108,13 @@ findposn(regex_t *ep, Tree *tp, int mb_cur_max)
 		if (ep->re_flags & REG_ICASE
 			&& (wc = to_upper(tp->op)) != tp->op)
 		{
-			if ((ptr = libuxre_reg1tree(tp->op, 0)) == 0)
+			if ((ptr = libuxre_reg1tree(lxp, tp->op, 0)) == 0)
 				return 0;
 			ptr->parent = tp;
 			ptr->left.pos = ep->re_dfa->nposn++;
 			tp->op = ROP_OR;
 			tp->left.ptr = ptr;
-			ptr = libuxre_reg1tree(wc, 0);
+			ptr = libuxre_reg1tree(lxp, wc, 0);
 			if ((tp->right.ptr = ptr) == 0)
 				return 0;
 			ptr->parent = tp;
@@ -135,25 +133,27 @@ findposn(regex_t *ep, Tree *tp, int mb_cur_max)
 	case ROP_END:
 		tp->left.pos = ep->re_dfa->nposn++;
 		return tp;
+	case ROP_LT:
+	case ROP_GT:
+		ep->re_dfa->angles = 1;
+		tp->left.pos = ep->re_dfa->nposn++;
+		return tp;
 	case ROP_EMPTY:
 		return tp;
 	case ROP_OR:
 	case ROP_CAT:
-		if ((tp->right.ptr = findposn(ep, tp->right.ptr,
-						mb_cur_max)) == 0)
+		if ((tp->right.ptr = findposn(ep, lxp, tp->right.ptr)) == 0)
 			return 0;
 		/*FALLTHROUGH*/
 	case ROP_STAR:
 	case ROP_PLUS:
 	case ROP_QUEST:
 	case ROP_LP:
-		if ((tp->left.ptr = findposn(ep, tp->left.ptr,
-						mb_cur_max)) == 0)
+		if ((tp->left.ptr = findposn(ep, lxp, tp->left.ptr)) == 0)
 			return 0;
 		return tp;
 	case ROP_BRACE:
-		if ((tp->left.ptr = findposn(ep, tp->left.ptr,
-						mb_cur_max)) == 0)
+		if ((tp->left.ptr = findposn(ep, lxp, tp->left.ptr)) == 0)
 			return 0;
 		break;
 	}
@@ -197,15 +197,15 @@ findposn(regex_t *ep, Tree *tp, int mb_cur_max)
 	par = tp->parent;
 	lo = tp->right.info.num[0];
 	hi = tp->right.info.num[1];
-	if ((ptr = copy(ep, tp->left.ptr)) == 0)
+	if ((ptr = copy(ep, lxp, tp->left.ptr)) == 0)
 		return 0;
 	ptr->parent = tp;
 	tp->op = ROP_CAT;
 	tp->right.ptr = ptr;
 	if (lo == 0)
 	{
-		if ((tp->left.ptr = libuxre_reg1tree(ROP_QUEST, tp->left.ptr))
-				== 0)
+		if ((tp->left.ptr = libuxre_reg1tree(lxp, ROP_QUEST,
+				tp->left.ptr)) == 0)
 			return 0;
 		tp->left.ptr->parent = tp;
 	}
@@ -215,29 +215,29 @@ findposn(regex_t *ep, Tree *tp, int mb_cur_max)
 			lo--;	/* lo > 1; no extra needed */
 		while (--lo != 0)
 		{
-			if ((tp = libuxre_reg2tree(ROP_CAT, tp, copy(ep, ptr)))
-					== 0)
+			if ((tp = libuxre_reg2tree(lxp, ROP_CAT, tp,
+					copy(ep, lxp, ptr))) == 0)
 				return 0;
 		}
 	}
 	if (hi == BRACE_INF)
 	{
-		if ((tp->right.ptr = libuxre_reg1tree(ROP_PLUS, tp->right.ptr))
-				== 0)
+		if ((tp->right.ptr = libuxre_reg1tree(lxp, ROP_PLUS,
+				tp->right.ptr)) == 0)
 			return 0;
 		tp->right.ptr->parent = tp;
 	}
 	else if (hi != 0)
 	{
-		if ((tp->right.ptr = libuxre_reg1tree(ROP_QUEST, tp->right.ptr))
-				== 0)
+		if ((tp->right.ptr = libuxre_reg1tree(lxp, ROP_QUEST,
+				tp->right.ptr)) == 0)
 			return 0;
 		ptr = tp->right.ptr;
 		ptr->parent = tp;
 		while (--hi != 0)
 		{
-			if ((tp = libuxre_reg2tree(ROP_CAT, tp, copy(ep, ptr)))
-					== 0)
+			if ((tp = libuxre_reg2tree(lxp, ROP_CAT, tp,
+					copy(ep, lxp, ptr))) == 0)
 				return 0;
 		}
 	}
@@ -245,6 +245,69 @@ findposn(regex_t *ep, Tree *tp, int mb_cur_max)
 	return tp;
 }
 
+	/*
+	* Sets of positions, such as a new state's signature or
+	* the follow set of a position, are collected sparsely:
+	* cursig[0..nset) lists its positions in the order added,
+	* and possparse[] maps a position back to its index there.
+	* Emptying the set is just resetting nset, so building
+	* one costs nothing per position that is not part of it.
+	*/
+#define	inset(dp, n)	((dp)->possparse[n] < (dp)->nset && \
+			(dp)->cursig[(dp)->possparse[n]] == (n))
+
+static void
+addpos(Dfa *dp, size_t n)
+{
+	if (!inset(dp, n))
+	{
+		dp->possparse[n] = dp->nset;
+		dp->cursig[dp->nset++] = n;
+	}
+}
+
+	/*
+	* Put the signature in ascending order, as addstate() needs
+	* it.  Small sets are sorted in place; larger ones are marked
+	* in posset[] and collected from there, leaving it cleared.
+	*/
+static void
+sortsig(Dfa *dp)
+{
+	size_t *sp;
+	size_t i, j, n, lo, hi;
+
+	sp = dp->cursig;
+	if ((n = dp->nset) <= 8)
+	{
+		for (i = 1; i < n; i++)
+		{
+			lo = sp[i];
+			for (j = i; j > 0 && sp[j - 1] > lo; j--)
+				sp[j] = sp[j - 1];
+			sp[j] = lo;
+		}
+		return;
+	}
+	lo = hi = sp[0];
+	for (i = 0; i < n; i++)
+	{
+		dp->posset[sp[i]] = 1;
+		if (sp[i] < lo)
+			lo = sp[i];
+		else if (sp[i] > hi)
+			hi = sp[i];
+	}
+	for (i = lo, j = 0; j < n; i++)
+	{
+		if (dp->posset[i] != 0)
+		{
+			dp->posset[i] = 0;
+			sp[j++] = i;
+		}
+	}
+}
+
 	/*
 	* Postorder traversal, but not always entire subtree.
 	* For each leaf reachable by the empty string, add it
@@ -283,11 +346,7 @@ first(Dfa *dp, Tree *tp)
 	case ROP_PLUS:
 		return first(dp, tp->left.ptr);
 	}
-	if (dp->posset[tp->left.pos] == 0)
-	{
-		dp->posset[tp->left.pos] = 1;
-		dp->nset++;
-	}
+	addpos(dp, tp->left.pos);
 	return 1;
 }
 
@@ -331,7 +390,6 @@ follow(Dfa *dp, Tree *tp)
 static int
 posnfoll(Dfa *dp, Tree *tp)
 {
-	unsigned char *s;
 	size_t i, n;
 	size_t *fp;
 	Posn *p;
@@ -372,10 +430,10 @@ posnfoll(Dfa *dp, Tree *tp)
 	p = &dp->posn[tp->left.pos];
 skip:;
 	p->op = tp->op;
-	memset(dp->posset, 0, dp->nposn);
 	dp->nset = 0;
 	follow(dp, tp);
 	dp->flags &= ~(REG_NOTBOL | REG_NOTEOL);
+	sortsig(dp);
 	fp = dp->posfoll;
 	if ((p->nset = dp->nset) > dp->avail) /* need more */
 	{
@@ -394,18 +452,7 @@ skip:;
 	{
 		dp->used += i;
 		dp->avail -= i;
-		fp += p->seti;
-		s = dp->posset;
-		n = 0;
-		do
-		{
-			if (*s++ != 0)
-			{
-				*fp++ = n;
-				if (--i == 0)
-					break;
-			}
-		} while (++n != dp->nposn);
+		memcpy(&fp[p->seti], dp->cursig, i * sizeof(size_t));
 	}
 	return 0;
 }
@@ -423,7 +470,7 @@ addstate(Dfa *dp) /* install state if unique; return its index */
 	t = dp->top;
 	do
 	{
-		if (dp->nsig[--t] != dp->nset)
+		if (dp->nsig[--t] != dp->nset || dp->word[t] != dp->curword)
 			continue;
 		if ((n = dp->nset) != 0)
 		{
@@ -441,9 +488,11 @@ addstate(Dfa *dp) /* install state if unique; return its index */
 	* Not in currently cached states; add it.
 	*/
 	flushed = 0;
+	dp->nstates++;
 	if ((t = dp->top) >= CACHESZ)	/* need to flush the cache */
 	{
 		flushed = 1;
+		dp->nflush++;
 		n = dp->anybol;
 		n = dp->sigi[n] + dp->nsig[n];	/* past invariant states */
 		dp->avail += dp->used - n;
@@ -464,6 +513,7 @@ addstate(Dfa *dp) /* install state if unique; return its index */
 		dp->sigfoll = fp;
 	}
 	dp->acc[t] = 0;
+	dp->word[t] = dp->curword;
 	if ((dp->nsig[t] = n) != 0)
 	{
 		sp = dp->cursig;
@@ -495,6 +545,10 @@ libuxre_regdeldfa(Dfa *dp)
 		free(dp->sigfoll);
 	if (dp->cursig != 0)
 		free(dp->cursig);
+	if (dp->sand != 0)
+		free(dp->sand);
+	if (dp->possparse != 0)
+		free(dp->possparse);
 	if ((pp = dp->posn) != 0)
 	{
 		/*
@@ -515,60 +569,146 @@ libuxre_regdeldfa(Dfa *dp)
 	free(dp);
 }
 
+	/*
+	* Return nonzero if the (non-assertion) position
+	* pp matches the character wc.
+	*/
+static int
+posmatch(Dfa *dp, Posn *pp, w_type wc, int mb_cur_max)
+{
+	switch (pp->op)
+	{
+	case ROP_EOL:
+		if (wc == '\0' && (dp->flags & REG_NOTEOL) == 0)
+			return 1;
+		/*FALLTHROUGH*/
+	case ROP_BOL:
+	default:
+		if (pp->op == wc)
+			return 1;
+		/*FALLTHROUGH*/
+	case ROP_END:
+	case ROP_NONE:
+	case ROP_LT:
+	case ROP_GT:
+		return 0;
+	case ROP_NOTNL:
+		if (wc == '\n')
+			return 0;
+		/*FALLTHROUGH*/
+	case ROP_ANYCH:
+		return wc > '\0';
+	case ROP_ALL:
+		return wc != '\0';
+	case ROP_BKT:
+	case ROP_BKTCOPY:
+		/*
+		* Note that multiple character bracket matches
+		* are precluded from DFAs.  (See regparse.c and
+		* regcomp.c.)  Thus, the continuation string
+		* argument is not used in libuxre_bktmbexec().
+		*/
+		return wc > '\0' &&
+		    libuxre_bktmbexec(pp->bkt, wc, 0, mb_cur_max) == 0;
+	}
+}
+
+	/*
+	* Add the follow set of position pp to the new state's
+	* signature.
+	*/
+static void
+addfoll(Dfa *dp, Posn *pp)
+{
+	size_t *sp;
+	size_t i;
+
+	i = pp->nset;
+	sp = &dp->posfoll[pp->seti];
+	do
+		addpos(dp, *sp);
+	while (++sp, --i != 0);
+}
+
+#define	isword(wc)	((wc) > '\0' && ((wc) == '_' || \
+			iswalnum(mb_cur_max == 1 ? btowc(wc) : (wint_t)(wc))))
+
+	/*
+	* \< and \> stay in a state's signature as they are and
+	* are decided on the next transition, when the character
+	* before (dp->word[st]) and the one after (wc) are both
+	* known.  Semantics are those of the NFA: \< holds at the
+	* start of the string and between a non-word and a word
+	* character, \> holds before any non-word character.  If
+	* it holds, the positions following the assertion are
+	* tried against wc in turn; reaching ROP_END means a match
+	* ends before wc, which makes the new state accepting.
+	* On the ROP_BOL pseudo-transition, the follow set of a
+	* \< that entered the new state is carried into it, just
+	* like that of a ROP_BOL position.
+	*/
+static void
+wordpass(Dfa *dp, size_t pos, int st, w_type wc, int mb_cur_max)
+{
+	Posn *pp, *qp;
+	size_t *sp;
+	size_t i;
+
+	if (dp->posmark[pos] != 0)
+		return;
+	dp->posmark[pos] = 1;
+	pp = &dp->posn[pos];
+	if (wc == ROP_BOL)
+		;
+	else if (pp->op == ROP_LT)
+	{
+		if (dp->word[st] != 0 || !isword(wc))
+			return;
+	}
+	else if (isword(wc))
+		return;
+	i = pp->nset;
+	sp = &dp->posfoll[pp->seti];
+	do
+	{
+		qp = &dp->posn[*sp];
+		if (wc == ROP_BOL)
+		{
+			if (qp->op == ROP_LT)
+				wordpass(dp, *sp, st, wc, mb_cur_max);
+			addpos(dp, *sp);
+		}
+		else if (qp->op == ROP_LT || qp->op == ROP_GT)
+			wordpass(dp, *sp, st, wc, mb_cur_max);
+		else if (qp->op == ROP_END)
+			addpos(dp, 0);
+		else if (posmatch(dp, qp, wc, mb_cur_max))
+			addfoll(dp, qp);
+	} while (++sp, --i != 0);
+}
+
 int
 regtrans(Dfa *dp, int st, w_type wc, int mb_cur_max)
 {
-	const unsigned char *s;
-	size_t *fp, *sp;
+	size_t *fp;
 	size_t i, n;
 	Posn *pp;
 	int nst;
 
+	dp->ntrans++;
 	if ((n = dp->nsig[st]) == 0)	/* dead state */
 		return st + 1;		/* stay here */
-	memset(dp->posset, 0, dp->nposn);
+	if (dp->angles)
+		memset(dp->posmark, 0, dp->nposn);
 	dp->nset = 0;
 	fp = &dp->sigfoll[dp->sigi[st]];
 	do
 	{
 		pp = &dp->posn[*fp];
-		switch (pp->op)
+		if (pp->op == ROP_LT || pp->op == ROP_GT)
 		{
-		case ROP_EOL:
-			if (wc == '\0' && (dp->flags & REG_NOTEOL) == 0)
-				break;
-			/*FALLTHROUGH*/
-		case ROP_BOL:
-		default:
-			if (pp->op == wc)
-				break;
-			/*FALLTHROUGH*/
-		case ROP_END:
-		case ROP_NONE:
-			continue;
-		case ROP_NOTNL:
-			if (wc == '\n')
-				continue;
-			/*FALLTHROUGH*/
-		case ROP_ANYCH:
-			if (wc <= '\0')
-				continue;
-			break;
-		case ROP_ALL:
-			if (wc == '\0')
-				continue;
-			break;
-		case ROP_BKT:
-		case ROP_BKTCOPY:
-			/*
-			* Note that multiple character bracket matches
-			* are precluded from DFAs.  (See regparse.c and
-			* regcomp.c.)  Thus, the continuation string
-			* argument is not used in libuxre_bktmbexec().
-			*/
-			if (wc > '\0' &&
-			    libuxre_bktmbexec(pp->bkt, wc, 0, mb_cur_max) == 0)
-				break;
+			if (wc != ROP_BOL)
+				wordpass(dp, *fp, st, wc, mb_cur_max);
 			continue;
 		}
 		/*
@@ -576,34 +716,27 @@ regtrans(Dfa *dp, int st, w_type wc, int mb_cur_max)
 		* For each position in its follow list,
 		* add that position to the new state's signature.
 		*/
-		i = pp->nset;
-		sp = &dp->posfoll[pp->seti];
-		do
-		{
-			if (dp->posset[*sp] == 0)
-			{
-				dp->posset[*sp] = 1;
-				dp->nset++;
-			}
-		} while (++sp, --i != 0);
+		if (posmatch(dp, pp, wc, mb_cur_max))
+			addfoll(dp, pp);
 	} while (++fp, --n != 0);
-	/*
-	* Move the signature (if any) into cursig[] and install it.
-	*/
-	if ((i = dp->nset) != 0)
+	if (dp->angles && wc == ROP_BOL)
 	{
-		fp = dp->cursig;
-		s = dp->posset;
-		for (n = 0;; n++)
+		for (i = 0; i < dp->nset; i++)
 		{
-			if (*s++ != 0)
-			{
-				*fp++ = n;
-				if (--i == 0)
-					break;
-			}
+			if (dp->posn[dp->cursig[i]].op == ROP_LT)
+				wordpass(dp, dp->cursig[i], st, wc, mb_cur_max);
 		}
 	}
+	/*
+	* Install the signature (if any).
+	*/
+	dp->curword = 0;
+	if (dp->nset != 0)
+	{
+		if (dp->angles && wc != ROP_BOL)
+			dp->curword = isword(wc) != 0;
+		sortsig(dp);
+	}
 	if ((nst = addstate(dp)) < 0) /* flushed cache */
 		nst = -nst;
 	else if (nst > 0 && (wc & ~(long)(NCHAR - 1)) == 0)
@@ -611,6 +744,144 @@ regtrans(Dfa *dp, int st, w_type wc, int mb_cur_max)
 	return nst;
 }
 
+#define	NMASKBIT	(sizeof(unsigned long) * CHAR_BIT)
+
+	/*
+	* Add the bytes matched by a column of the Shift-And form:
+	* a single position or an alternation of single positions
+	* (which REG_ICASE makes of characters).
+	*/
+static int
+sacol(Dfa *dp, Tree *tp, unsigned long bit)
+{
+	Posn *pp;
+	int c;
+
+	switch (tp->op)
+	{
+	case ROP_LP:
+		return sacol(dp, tp->left.ptr, bit);
+	case ROP_OR:
+		return sacol(dp, tp->left.ptr, bit)
+			&& sacol(dp, tp->right.ptr, bit);
+	case ROP_ANYCH:
+	case ROP_NOTNL:
+	case ROP_BKT:
+	case ROP_BKTCOPY:
+		break;
+	default:
+		if (tp->op < 0)
+			return 0;
+		break;
+	}
+	pp = &dp->posn[tp->left.pos];
+	for (c = 1; c < NCHAR; c++)
+	{
+		if (c != '\n' && posmatch(dp, pp, c, 1))
+			dp->sand->mask[c] |= bit;
+	}
+	return 1;
+}
+
+	/*
+	* Append the columns of a concatenation to the Shift-And
+	* form.  Each column may be optional (ROP_QUEST), may repeat
+	* (ROP_PLUS), or both (ROP_STAR); this is also the shape of
+	* a ROP_BRACE after findposn() has expanded it.
+	*/
+static int
+saseq(Dfa *dp, Tree *tp)
+{
+	Sand *sp = dp->sand;
+	unsigned long bit;
+
+	switch (tp->op)
+	{
+	case ROP_CAT:
+		return saseq(dp, tp->left.ptr) && saseq(dp, tp->right.ptr);
+	case ROP_LP:
+		return saseq(dp, tp->left.ptr);
+	}
+	if (sp->ncol == NMASKBIT)
+		return 0;
+	bit = 1UL << sp->ncol++;
+	switch (tp->op)
+	{
+	case ROP_BOL:
+		if (bit != 1)
+			return 0;
+		sp->mask['\n'] |= bit;
+		return 1;
+	case ROP_EOL:
+		sp->eol |= bit;
+		sp->mask['\n'] |= bit;
+		sp->mask['\0'] |= bit;
+		return 1;
+	case ROP_STAR:
+		sp->opt |= bit;
+		/*FALLTHROUGH*/
+	case ROP_PLUS:
+		sp->rep |= bit;
+		return sacol(dp, tp->left.ptr, bit);
+	case ROP_QUEST:
+		sp->opt |= bit;
+		return sacol(dp, tp->left.ptr, bit);
+	}
+	return sacol(dp, tp, bit);
+}
+
+	/*
+	* Derive the Shift-And form of the pattern tp for a search
+	* in a singlebyte locale, if it is a sequence of at most as
+	* many columns as there are bits in a long.  Bit j of mask[c]
+	* is set if byte c matches column j.  ROP_BOL may only be the
+	* first column and is taken to match the newline before the
+	* line; ROP_EOL may only be the last one and matches the
+	* newline or NUL after it.  Optional columns are skipped by
+	* the epsilon closure of Navarro and Raffinot: for each run
+	* of them, first has the bit of the column before the run
+	* and last that of its final column.  A counted repetition
+	* x{m,n} thus costs n columns, but no DFA states.
+	*/
+static void
+shiftand(Dfa *dp, Tree *tp)
+{
+	Sand *sp;
+	unsigned long bit, d, df;
+	int j;
+
+	if ((sp = dp->sand = calloc(1, sizeof(Sand))) == 0)
+		return;
+	/*
+	* The first column must not be optional, the only ROP_EOL
+	* must be the last one, and there must be some column other
+	* than ROP_BOL that is not optional.
+	*/
+	if (saseq(dp, tp) == 0 || sp->opt & 1
+		|| sp->eol & ~(1UL << (sp->ncol - 1))
+		|| (~sp->opt & (~0UL >> (NMASKBIT - sp->ncol))
+			& ~(sp->mask['\n'] & ~sp->eol & 1)) == 0)
+	{
+		free(sp);
+		dp->sand = 0;
+		return;
+	}
+	sp->acc = 1UL << (sp->ncol - 1);
+	for (j = 1; j < sp->ncol; j++)
+	{
+		bit = 1UL << j;
+		if ((sp->opt & bit) == 0)
+			continue;
+		if ((sp->opt & bit >> 1) == 0)
+			sp->first |= bit >> 1;
+		if (j + 1 == sp->ncol || (sp->opt & bit << 1) == 0)
+			sp->last |= bit;
+	}
+	d = 1 & sp->mask['\n'];
+	df = d | sp->last;
+	sp->start = d | (sp->opt & (~(df - sp->first) ^ df));
+}
+
 LIBUXRE_STATIC int
 libuxre_regdfacomp(regex_t *ep, Tree *tp, Lex *lxp)
 {
@@ -626,10 +897,10 @@ libuxre_regdfacomp(regex_t *ep, Tree *tp, Lex *lxp)
 	* and the initial state signature will fall out when
 	* building the follow sets for all the leaves.
 	*/
-	if ((lp = libuxre_reg1tree(ROP_ALL, 0)) == 0
-		|| (lp = libuxre_reg1tree(ROP_STAR, lp)) == 0
+	if ((lp = libuxre_reg1tree(lxp, ROP_ALL, 0)) == 0
+		|| (lp = libuxre_reg1tree(lxp, ROP_STAR, lp)) == 0
 		|| (tp->left.ptr = lp
-			= libuxre_reg2tree(ROP_CAT, lp, tp->left.ptr)) == 0)
+			= libuxre_reg2tree(lxp, ROP_CAT, lp, tp->left.ptr)) == 0)
 	{
 		return REG_ESPACE;
 	}
@@ -643,6 +914,8 @@ libuxre_regdfacomp(regex_t *ep, Tree *tp, Lex *lxp)
 	dp->posfoll = 0;
 	dp->sigfoll = 0;
 	dp->cursig = 0;
+	dp->possparse = 0;
+	dp->sand = 0;
 	dp->posn = 0;
 	/*
 	* Assign position values to each of the tree's leaves
@@ -650,20 +923,28 @@ libuxre_regdfacomp(regex_t *ep, Tree *tp, Lex *lxp)
 	* the parse tree so that it fits within the restrictions
 	* of our DFA.
 	*/
-	if ((tp = findposn(ep, tp, lxp->mb_cur_max)) == 0)
+	if ((tp = findposn(ep, lxp, tp)) == 0)
 		goto err;
 	/*
 	* Get space for the array of positions and current set,
 	* now that the number of positions is known.
 	*/
-	if ((dp->posn = malloc(sizeof(Posn) * dp->nposn + dp->nposn)) == 0)
+	if ((dp->posn = malloc(sizeof(Posn) * dp->nposn
+			+ dp->nposn * (dp->angles ? 2 : 1))) == 0)
 		goto err;
 	dp->posset = (unsigned char *)&dp->posn[dp->nposn];
+	dp->posmark = &dp->posset[dp->nposn];
+	memset(dp->posset, 0, dp->nposn);	/* kept clear by sortsig() */
+	if ((dp->cursig = malloc(sizeof(size_t) * dp->nposn)) == 0
+		|| (dp->possparse = calloc(dp->nposn, sizeof(size_t))) == 0)
+		goto err;
 	/*
 	* Get follow sets for each position.
 	*/
 	if (posnfoll(dp, tp) != 0)
 		goto err;
+	if (lxp->mb_cur_max == 1)
+		shiftand(dp, tp->left.ptr->right.ptr);
 	/*
 	* Set up the special invariant states:
 	*  - dead state (no valid transitions); index 0.
@@ -680,12 +961,10 @@ libuxre_regdfacomp(regex_t *ep, Tree *tp, Lex *lxp)
 	if ((dp->sigfoll = malloc(sizeof(size_t) * dp->avail)) == 0)
 		goto err;
 	p = &dp->posn[dp->nposn - 1];	/* same as first(root) */
-	dp->cursig = &dp->posfoll[p->seti];
+	memcpy(dp->cursig, &dp->posfoll[p->seti], p->nset * sizeof(size_t));
 	dp->nset = p->nset;
 	dp->top = 1;	/* index 0 is dead state */
 	addstate(dp);	/* must be state index 1 (returns 2) */
-	if ((dp->cursig = malloc(sizeof(size_t) * dp->nposn)) == 0)
-		goto err;
 	dp->nfix = 2;
 	if ((st = regtrans(dp, 1, ROP_BOL, lxp->mb_cur_max)) == 0)
 		goto err;
@@ -47,20 +47,42 @@ typedef struct
 #define CACHESZ	32	/* max. states to remember (must fit in uchar) */
 #define NCHAR	(1 << CHAR_BIT)
 
+typedef struct	/* Shift-And form of a pattern */
+{
+	unsigned long	mask[NCHAR];		/* columns matched by byte */
+	unsigned long	opt;		/* optional columns */
+	unsigned long	rep;		/* repeatable columns */
+	unsigned long	first;		/* column before a run of optional */
+	unsigned long	last;		/* last column of such a run */
+	unsigned long	eol;		/* ROP_EOL column */
+	unsigned long	acc;		/* final column */
+	unsigned long	start;		/* state at start of line */
+	int		ncol;		/* number of columns */
+} Sand;
+
 struct re_dfa_ /*Dfa*/
 {
 	unsigned char	*posset;	/* signatures built here */
+	unsigned char	*posmark;	/* \< \> tried in this transition */
 	size_t		*posfoll;	/* follow strip for posn[] */
 	size_t		*sigfoll;	/* follow strip for sigi[] */
 	size_t		*cursig;	/* current state's signature */
+	size_t		*possparse;	/* index of a position in cursig[] */
 	Posn		*posn;		/* important positions */
+	Sand		*sand;		/* Shift-And form, if any */
 	size_t		nposn;		/* length of posn,cursig,posset */
 	size_t		used;		/* used portion of follow strip */
 	size_t		avail;		/* unused part of follow strip */
-	size_t		nset;		/* # items nonzero in posset[] */
+	size_t		nset;		/* # items in the set being built */
+	unsigned long	nstates;	/* states built, for statistics */
+	unsigned long	nflush;		/* cache flushes, likewise */
+	unsigned long	ntrans;		/* regtrans() calls, likewise */
 	size_t		nsig[CACHESZ];	/* number of items in signature */
 	size_t		sigi[CACHESZ];	/* index into sigfoll[] */
 	unsigned char	acc[CACHESZ];	/* nonzero for accepting states */
+	unsigned char	word[CACHESZ];	/* entered through a word character */
+	unsigned char	curword;	/* word[] value for cursig[] */
+	unsigned char	angles;		/* \< or \> among the positions */
 	unsigned char	leftmost;	/* leftmost() start, not BOL */
 	unsigned char	leftbol;	/* leftmost() start, w/BOL */
 	unsigned char	anybol;		/* any match start, w/BOL */
@@ -142,6 +142,7 @@ extern "C" {
 #endif
 
 int	regcomp(regex_t *, const char *, int);
+int	regrevcomp(regex_t *, const char *, int);
 int	regexec(const regex_t *, const char *, size_t, regmatch_t *, int);
 size_t	regerror(int, const regex_t *, char *, size_t);
 void	regfree(regex_t *);
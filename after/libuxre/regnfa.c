@@ -81,6 +81,7 @@ struct t_ctxt
 struct re_nfa_ /*Nfa*/
 {
 	Graph	*gp;	/* entire NFA */
+	Pool	*pool;	/* holds the Graph nodes */
 	Stack	*sp;	/* unused Stacks */
 	Stack	*allsp;	/* linked Stacks (for cleanup) */
 	Context	*allcp;	/* linked Contexts (for cleanup) */
@@ -128,8 +129,8 @@ deltolist(Graph *gp, Graph **list)
 }
 
 	/*
-	* After the list is turned into a linked list,
-	* walk that list freeing the nodes.
+	* The nodes belong to the pool; turning the graph into a
+	* list frees the Brackets it owns.
 	*/
 static void
 delgraph(Graph *gp)
@@ -138,11 +139,6 @@ delgraph(Graph *gp)
 
 	gp2 = &end;
 	deltolist(gp, &gp2);
-	while ((gp = gp2) != &end)
-	{
-		gp2 = gp->alt.ptr;
-		free(gp);
-	}
 }
 
 	/*
@@ -184,14 +180,14 @@ nopskip(Graph *gp, Graph **nop)
 	*	 -1 => error (in allocation)
 	*/
 static int
-mkgraph(Tree *tp, Graph **first, Graph **last)
+mkgraph(Nfa *np, Tree *tp, Graph **first, Graph **last)
 {
 	Graph *new = 0, *nop, *lf, *ll, *rf, *rl;
 	int lmt, rmt = 0;
 
 	if (tp->op != ROP_CAT)
 	{
-		if ((new = malloc(sizeof(Graph))) == 0)
+		if ((new = libuxre_palloc(&np->pool, sizeof(Graph))) == 0)
 			return 0;
 		new->op = tp->op;	/* usually */
 	}
@@ -221,7 +217,7 @@ mkgraph(Tree *tp, Graph **first, Graph **last)
 	case ROP_OR:
 	case ROP_CAT:
 		lf = 0;	/* in case of error */
-		if ((rmt = mkgraph(tp->right.ptr, &rf, &rl)) < 0)
+		if ((rmt = mkgraph(np, tp->right.ptr, &rf, &rl)) < 0)
 			goto err;
 		/*FALLTHROUGH*/
 	case ROP_STAR:
@@ -229,7 +225,7 @@ mkgraph(Tree *tp, Graph **first, Graph **last)
 	case ROP_QUEST:
 	case ROP_BRACE:
 	case ROP_LP:
-		if ((lmt = mkgraph(tp->left.ptr, &lf, &ll)) < 0)
+		if ((lmt = mkgraph(np, tp->left.ptr, &lf, &ll)) < 0)
 			goto err;
 		break;
 	}
@@ -242,7 +238,7 @@ mkgraph(Tree *tp, Graph **first, Graph **last)
 	switch (tp->op)
 	{
 	case ROP_OR:
-		if ((nop = malloc(sizeof(Graph))) == 0)
+		if ((nop = libuxre_palloc(&np->pool, sizeof(Graph))) == 0)
 			goto err;
 		nop->op = ROP_NOP;
 		nop->alt.ptr = 0;	/* untouched */
@@ -259,7 +255,7 @@ mkgraph(Tree *tp, Graph **first, Graph **last)
 		*last = rl;
 		return lmt & rmt;
 	case ROP_QUEST:
-		if ((nop = malloc(sizeof(Graph))) == 0)
+		if ((nop = libuxre_palloc(&np->pool, sizeof(Graph))) == 0)
 			goto err;
 		nop->op = ROP_NOP;
 		nop->alt.ptr = 0;	/* untouched */
@@ -284,7 +280,7 @@ mkgraph(Tree *tp, Graph **first, Graph **last)
 		rmt = lmt;
 		goto star;
 	case ROP_BRACE:
-		if ((nop = malloc(sizeof(Graph))) == 0)
+		if ((nop = libuxre_palloc(&np->pool, sizeof(Graph))) == 0)
 			goto err;
 		nop->op = ROP_MTOR; /* going to save state anyway... */
 		nop->alt.ptr = lf;
@@ -306,7 +302,7 @@ mkgraph(Tree *tp, Graph **first, Graph **last)
 		*last = nop;
 		return lmt;
 	case ROP_LP:
-		if ((nop = malloc(sizeof(Graph))) == 0)
+		if ((nop = libuxre_palloc(&np->pool, sizeof(Graph))) == 0)
 			goto err;
 		nop->op = ROP_RP;
 		nop->alt.info.sub = tp->right.info.sub;
@@ -322,8 +318,6 @@ err:;
 		delgraph(rf);
 	if (lf != 0)
 		delgraph(lf);
-	if (tp->op != ROP_CAT)
-		free(new);
 	return -1;
 }
 
@@ -384,6 +378,7 @@ libuxre_regdelnfa(Nfa *np)
 		spn = sp->link;
 		free(sp);
 	}
+	libuxre_pfree(&np->pool);
 	free(np);
 }
 
@@ -396,7 +391,8 @@ libuxre_regnfacomp(regex_t *ep, Tree *tp, Lex *lxp)
 	if ((np = malloc(sizeof(Nfa))) == 0)
 		goto err;
 	np->gp = 0; /* in case of error */
-	if (mkgraph(tp, &np->gp, &gp) < 0)
+	np->pool = 0;
+	if (mkgraph(np, tp, &np->gp, &gp) < 0)
 		goto err;
 	gp->next = 0;	/* nothing follows ROP_END */
 	np->rmlen = 0;
@@ -408,17 +404,11 @@ libuxre_regnfacomp(regex_t *ep, Tree *tp, Lex *lxp)
 	/*
 	* Delete all ROP_NOPs from the graph.
 	* nopskip() disconnects them from the graph and
-	* links them together through their alt.ptr's.
+	* links them together through their alt.ptr's;
+	* they stay in the pool.
 	*/
 	gp = &end;
 	np->gp = nopskip(np->gp, &gp);
-	while (gp != &end)
-	{
-		Graph *gp2 = gp;
-
-		gp = gp->alt.ptr;
-		free(gp2);
-	}
 	np->sp = 0;
 	np->allsp = 0;
 	np->avail = 0;
@@ -431,6 +421,7 @@ err:;
 	{
 		if (np->gp != 0)
 			delgraph(np->gp);
+		libuxre_pfree(&np->pool);
 		free(np);
 	}
 	return REG_ESPACE;
@@ -30,10 +30,66 @@
 #include <ctype.h>
 #include "re.h"
 
+	/*
+	* Parse trees and NFA graphs consist of many small nodes
+	* that all go away together.  They are carved from large
+	* blocks instead of being allocated one by one, and only
+	* the blocks are freed.
+	*/
+#define POOLSZ	(64 * 1024)
+
+struct t_pool
+{
+	Pool	*next;	/* earlier block */
+	size_t	used;
+	size_t	size;
+	union { long l; double d; void *p; } data[1];
+};
+
+LIBUXRE_STATIC void *
+libuxre_palloc(Pool **pp, size_t n)
+{
+	Pool *p;
+	size_t sz;
+
+	sz = sizeof(p->data[0]);
+	n = (n + sz - 1) / sz * sz;
+	if ((p = *pp) == 0 || p->size - p->used < n)
+	{
+		if ((sz = POOLSZ) < n)
+			sz = n;
+		if ((p = malloc(sizeof(Pool) + sz)) == 0)
+			return 0;
+		p->next = *pp;
+		p->used = 0;
+		p->size = sz;
+		*pp = p;
+	}
+	p->used += n;
+	return (char *)p->data + p->used - n;
+}
+
+LIBUXRE_STATIC void
+libuxre_pfree(Pool **pp)
+{
+	Pool *p;
+
+	while ((p = *pp) != 0)
+	{
+		*pp = p->next;
+		free(p);
+	}
+}
+
+	/*
+	* The nodes themselves belong to the pool; only the
+	* Brackets are freed here, if they are not owned by an
+	* engine yet.
+	*/
 LIBUXRE_STATIC void
 libuxre_regdeltree(Tree *tp, int all)
 {
-	if (tp == 0)
+	if (tp == 0 || all == 0)
 		return;
 	if (tp->op < 0)
 	{
@@ -46,7 +102,7 @@ libuxre_regdeltree(Tree *tp, int all)
 			libuxre_regdeltree(tp->left.ptr, all);
 			break;
 		default:
-			if (tp->op == ROP_BKT && all)
+			if (tp->op == ROP_BKT)
 			{
 				libuxre_bktfree(tp->right.info.bkt);
 				free(tp->right.info.bkt);
@@ -54,15 +110,14 @@ libuxre_regdeltree(Tree *tp, int all)
 			break;
 		}
 	}
-	free(tp);
 }
 
 LIBUXRE_STATIC Tree *
-libuxre_reg1tree(w_type op, Tree *lp)
+libuxre_reg1tree(Lex *lxp, w_type op, Tree *lp)
 {
 	Tree *tp;
 
-	if ((tp = malloc(sizeof(Tree))) == 0)
+	if ((tp = libuxre_palloc(&lxp->pool, sizeof(Tree))) == 0)
 	{
 		if (lp != 0)
 			libuxre_regdeltree(lp, 1);
@@ -76,11 +131,11 @@ libuxre_reg1tree(w_type op, Tree *lp)
 }
 
 LIBUXRE_STATIC Tree *
-libuxre_reg2tree(w_type op, Tree *lp, Tree *rp)
+libuxre_reg2tree(Lex *lxp, w_type op, Tree *lp, Tree *rp)
 {
 	Tree *tp;
 
-	if ((tp = malloc(sizeof(Tree))) == 0)
+	if ((tp = libuxre_palloc(&lxp->pool, sizeof(Tree))) == 0)
 	{
 		libuxre_regdeltree(lp, 1);
 		libuxre_regdeltree(rp, 1);
@@ -485,14 +540,22 @@ nextc:	switch (wc = *lxp->pat++) /* interesting ones are single bytes */
 		case '<':
 			if (lxp->flags & REG_ANGLES)
 			{
-				lxp->flags |= REG_NFA;
+				/*
+				* The DFA decides \< and \> only for plain
+				* matches; see regtrans().
+				*/
+				if ((lxp->flags & (REG_NOSUB | REG_NEWLINE))
+						!= REG_NOSUB)
+					lxp->flags |= REG_NFA;
 				wc = ROP_LT;
 			}
 			goto out;
 		case '>':
 			if (lxp->flags & REG_ANGLES)
 			{
-				lxp->flags |= REG_NFA;
+				if ((lxp->flags & (REG_NOSUB | REG_NEWLINE))
+						!= REG_NOSUB)
+					lxp->flags |= REG_NFA;
 				wc = ROP_GT;
 			}
 			goto out;
@@ -691,7 +754,7 @@ leaf(Lex *lxp)
 {
 	Tree *tp;
 
-	if ((tp = malloc(sizeof(Tree))) == 0)
+	if ((tp = libuxre_palloc(&lxp->pool, sizeof(Tree))) == 0)
 	{
 		lxp->err = REG_ESPACE;
 		return 0;
@@ -775,7 +838,7 @@ leaf(Lex *lxp)
 			lxp->tok = ROP_EMPTY;
 			if (lxp->flags & REG_MTPARENFAIL)
 				lxp->tok = ROP_NONE;
-			if ((tp->left.ptr = libuxre_reg1tree(lxp->tok, 0)) == 0)
+			if ((tp->left.ptr = libuxre_reg1tree(lxp, lxp->tok, 0)) == 0)
 				goto badunary;
 		}
 		else if ((tp->left.ptr = alt(lxp)) == 0)
@@ -821,7 +884,7 @@ post(Lex *lxp)
 	case ROP_STAR:
 	case ROP_PLUS:
 	case ROP_QUEST:
-		if ((lp = libuxre_reg1tree(lxp->tok, lp)) == 0)
+		if ((lp = libuxre_reg1tree(lxp, lxp->tok, lp)) == 0)
 		{
 			lxp->err = REG_ESPACE;
 			return 0;
@@ -856,7 +919,7 @@ cat(Lex *lxp)
 		}
 		if ((rp = post(lxp)) == 0)
 			break;
-		if ((lp = libuxre_reg2tree(ROP_CAT, lp, rp)) == 0)
+		if ((lp = libuxre_reg2tree(lxp, ROP_CAT, lp, rp)) == 0)
 		{
 			lxp->err = REG_ESPACE;
 			return 0;
@@ -883,7 +946,7 @@ alt(Lex *lxp)
 			return lp;	/* ignore trailing '|' */
 		if ((rp = cat(lxp)) == 0)
 			break;
-		if ((lp = libuxre_reg2tree(ROP_OR, lp, rp)) == 0)
+		if ((lp = libuxre_reg2tree(lxp, ROP_OR, lp, rp)) == 0)
 		{
 			lxp->err = REG_ESPACE;
 			return 0;
@@ -907,6 +970,7 @@ libuxre_regparse(Lex *lxp, const unsigned char *pat, int flags)
 	lxp->nright = 0;
 	lxp->nclist = 0;
 	lxp->mb_cur_max = MB_CUR_MAX;
+	lxp->pool = 0;
 	if (flags & REG_OR && *pat == '|')
 		pat++;	/* skip initial OR like egrep did */
 	lxp->pat = pat;
@@ -936,13 +1000,13 @@ libuxre_regparse(Lex *lxp, const unsigned char *pat, int flags)
 		goto err;
 	if (lxp->maxref != 0 || (flags & REG_NOSUB) == 0)
 	{
-		if ((lp = libuxre_reg1tree(ROP_LP, lp)) == 0)
+		if ((lp = libuxre_reg1tree(lxp, ROP_LP, lp)) == 0)
 			goto err;
 		lp->right.info.sub = 0;
 	}
-	if ((rp = libuxre_reg1tree(ROP_END, 0)) == 0)
+	if ((rp = libuxre_reg1tree(lxp, ROP_END, 0)) == 0)
 		goto err;
-	if ((lp = libuxre_reg2tree(ROP_CAT, lp, rp)) == 0)
+	if ((lp = libuxre_reg2tree(lxp, ROP_CAT, lp, rp)) == 0)
 		goto err;
 	lp->parent = 0;
 ret:;
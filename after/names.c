@@ -0,0 +1,204 @@
+/*
+ * grep - search a file for a pattern
+ *
+ * Gunnar Ritter, Freiburg i. Br., Germany, April 2001.
+ */
+/*
+ * Copyright (c) 2003 Gunnar Ritter
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute
+ * it freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+/*
+ * Lists of shell patterns for file names (--include, --exclude,
+ * --exclude-dir).
+ *
+ * Nearly all patterns given in practice are a plain name (.git), a
+ * suffix (*.o), or a prefix (core*). These go into hash tables, so a
+ * name is matched against all of them with one lookup for each of its
+ * suffixes and prefixes; the hashes of these are computed incrementally
+ * from the ends of the name. Only the remaining patterns are tried one
+ * after the other with gmatch().
+ */
+
+#include "alloc.h"
+#include "grep.h"
+#include <stdlib.h>
+#include <string.h>
+
+extern int gmatch(const char *, const char *);
+
+struct nment {
+	struct nment *g_nxt;
+	unsigned g_hash;
+	size_t g_len;
+	char *g_str;
+};
+
+#define	NMMETA	"*?[\\"		/* characters special to gmatch() */
+
+/*
+ * Hashes of s[0..n), adding a character at the end or at the start.
+ */
+#define	hfwd(h, c)	((h) * 33 ^ ((c) & 0377))
+#define	hrev(h, c)	((h) * 31 + ((c) & 0377))
+
+static unsigned hashfwd(const char *s, size_t n)
+{
+	unsigned h = 5381;
+
+	while (n--)
+		h = hfwd(h, *s++);
+	return h;
+}
+
+static unsigned hashrev(const char *s, size_t n)
+{
+	unsigned h = 5381;
+
+	while (n--)
+		h = hrev(h, s[n]);
+	return h;
+}
+
+static void nm_put(struct nmset *sp, const char *s, size_t n, unsigned h)
+{
+	struct nment *gp, **tab;
+	unsigned i, size;
+
+	for (gp = sp->s_tab ? sp->s_tab[h & (sp->s_size - 1)] : NULL; gp;
+			gp = gp->g_nxt)
+		if (gp->g_hash == h && gp->g_len == n &&
+				memcmp(gp->g_str, s, n) == 0)
+			return;
+	if (sp->s_cnt >= sp->s_size) {
+		size = sp->s_size ? sp->s_size * 2 : 16;
+		tab = scalloc(size, sizeof *tab);
+		for (i = 0; i < sp->s_size; i++)
+			while ((gp = sp->s_tab[i]) != NULL) {
+				sp->s_tab[i] = gp->g_nxt;
+				gp->g_nxt = tab[gp->g_hash & (size - 1)];
+				tab[gp->g_hash & (size - 1)] = gp;
+			}
+		free(sp->s_tab);
+		sp->s_tab = tab;
+		sp->s_size = size;
+	}
+	gp = smalloc(sizeof *gp);
+	gp->g_str = smalloc(n);
+	memcpy(gp->g_str, s, n);
+	gp->g_len = n;
+	gp->g_hash = h;
+	gp->g_nxt = sp->s_tab[h & (sp->s_size - 1)];
+	sp->s_tab[h & (sp->s_size - 1)] = gp;
+	sp->s_cnt++;
+}
+
+static int nm_get(const struct nmset *sp, const char *s, size_t n, unsigned h)
+{
+	struct nment *gp;
+
+	for (gp = sp->s_tab[h & (sp->s_size - 1)]; gp; gp = gp->g_nxt)
+		if (gp->g_hash == h && gp->g_len == n &&
+				memcmp(gp->g_str, s, n) == 0)
+			return 1;
+	return 0;
+}
+
+/*
+ * Add a pattern to a list.
+ */
+void nm_add(struct nmlist *lp, const char *pat)
+{
+	size_t n = strlen(pat);
+
+	if (strpbrk(pat, NMMETA) == NULL)
+		nm_put(&lp->l_name, pat, n, hashfwd(pat, n));
+	else if (pat[0] == '*' && strpbrk(&pat[1], NMMETA) == NULL)
+		nm_put(&lp->l_suf, &pat[1], n - 1, hashrev(&pat[1], n - 1));
+	else if (strcspn(pat, NMMETA) == n - 1 && pat[n-1] == '*')
+		nm_put(&lp->l_pre, pat, n - 1, hashfwd(pat, n - 1));
+	else {
+		lp->l_pat = srealloc(lp->l_pat, (lp->l_npat + 1) *
+				sizeof *lp->l_pat);
+		lp->l_pat[lp->l_npat] = smalloc(n + 1);
+		strcpy(lp->l_pat[lp->l_npat++], pat);
+	}
+	lp->l_any = 1;
+}
+
+/*
+ * Does name match a pattern in the list?
+ */
+int nm_match(const struct nmlist *lp, const char *name)
+{
+	size_t n = strlen(name), i;
+	unsigned h;
+	int j;
+
+	if (lp->l_name.s_cnt && nm_get(&lp->l_name, name, n,
+				hashfwd(name, n)))
+		return 1;
+	if (lp->l_suf.s_cnt)
+		for (h = 5381, i = n + 1; i-- > 0; ) {
+			if (nm_get(&lp->l_suf, &name[i], n - i, h))
+				return 1;
+			if (i)
+				h = hrev(h, name[i-1]);
+		}
+	if (lp->l_pre.s_cnt)
+		for (h = 5381, i = 0; i <= n; i++) {
+			if (nm_get(&lp->l_pre, name, i, h))
+				return 1;
+			if (i < n)
+				h = hfwd(h, name[i]);
+		}
+	for (j = 0; j < lp->l_npat; j++)
+		if (gmatch(name, lp->l_pat[j]))
+			return 1;
+	return 0;
+}
+
+/*
+ * Free the patterns in a list, leaving it empty.
+ */
+void nm_free(struct nmlist *lp)
+{
+	struct nmset *sets[3];
+	struct nment *gp;
+	unsigned i;
+	int j;
+
+	sets[0] = &lp->l_name;
+	sets[1] = &lp->l_suf;
+	sets[2] = &lp->l_pre;
+	for (j = 0; j < 3; j++) {
+		for (i = 0; i < sets[j]->s_size; i++)
+			while ((gp = sets[j]->s_tab[i]) != NULL) {
+				sets[j]->s_tab[i] = gp->g_nxt;
+				free(gp->g_str);
+				free(gp);
+			}
+		free(sets[j]->s_tab);
+	}
+	for (j = 0; j < lp->l_npat; j++)
+		free(lp->l_pat[j]);
+	free(lp->l_pat);
+	memset(lp, 0, sizeof *lp);
+}
@@ -0,0 +1,113 @@
+/*
+ * grep - search a file for a pattern
+ *
+ * Gunnar Ritter, Freiburg i. Br., Germany, April 2001.
+ */
+/*
+ * Copyright (c) 2003 Gunnar Ritter
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute
+ * it freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+/*
+ * Decisions on pattern lists shared by the search library and the
+ * commands, so that both take the same matcher for the same patterns.
+ */
+
+#include "grep.h"
+#include "public.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Check whether the pattern list is better searched for as fixed
+ * strings: it must consist of more than four patterns without special
+ * characters. Up to four strings are left to the Shift-And and DFA
+ * kernels, which are faster for them; larger sets make the small DFA
+ * state cache thrash, whereas Aho-Corasick is insensitive to the
+ * number of strings. There is no Aho-Corasick range kernel for -i, so
+ * such sets stay with the DFA too, and so do sets with -w. The caller
+ * leaves out empty patterns.
+ */
+int gl_fixedset(struct expr *e0, int flags)
+{
+	struct expr *e;
+	const char *cp, *meta;
+	int n, m;
+
+	if (flags & (GREP_WORD|GREP_ICASE))
+		return 0;
+	meta = flags & GREP_EXTENDED ? "\\^$.[*+?{()|" : "\\^$.[*";
+	for (n = 0, e = e0; e; e = e->e_nxt, n++) {
+		for (cp = e->e_pat; cp < &e->e_pat[e->e_len]; cp += m) {
+			if (*cp == '\0' || strchr(meta, *cp) != NULL)
+				return 0;
+			m = 1;
+			if (MB_CUR_MAX > 1 && *cp & 0200 &&
+			    (m = mblen(cp, &e->e_pat[e->e_len] - cp)) <= 0)
+				return 0;
+		}
+	}
+	return n > 4;
+}
+
+/*
+ * Whether a basic expression ends with an unescaped $.
+ */
+static int gl_dollar(const char *pat, long len)
+{
+	int dollar = 1;
+
+	if (len == 0 || pat[len - 1] != '$')
+		return 0;
+	pat += --len - 1;
+	while (len-- && *pat-- == '\\')
+		dollar = !dollar;
+	return dollar;
+}
+
+/*
+ * Copy the basic expression pat to dst surrounded by \< \>, keeping a
+ * leading ^ and a trailing $ outside. dst must hold len + 4 bytes; the
+ * new length is returned.
+ */
+size_t gl_wrap(char *dst, const char *pat, size_t len)
+{
+	char *cp = dst;
+	int dollar = gl_dollar(pat, len);
+
+	if (len > 0 && pat[0] == '^') {
+		*cp++ = '^';
+		pat++;
+		len--;
+	}
+	if (dollar)
+		len--;
+	memcpy(cp, "\\<", 2);
+	memcpy(&cp[2], pat, len);
+	cp += len + 2;
+	if (dollar) {
+		memcpy(cp, "\\>$", 3);
+		cp += 3;
+	} else {
+		memcpy(cp, "\\>", 2);
+		cp += 2;
+	}
+	return cp - dst;
+}
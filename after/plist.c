@@ -33,6 +33,7 @@
 
 #include <ctype.h>
 #include <fcntl.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -44,20 +45,23 @@
 #include "grep.h"
 #include "public.h"
 
+struct arena patarena; /* expression list */
+
 /*
  * Add a pattern starting at the given node of the expression list.
  */
 static void addpat(struct expr **e, char *pat, long len, enum eflags flg)
 {
 	if (e0) {
-		(*e)->e_nxt = (struct expr *)smalloc(sizeof **e);
+		(*e)->e_nxt = aalloc(&patarena, sizeof **e);
 		(*e) = (*e)->e_nxt;
 	} else
-		e0 = (*e) = (struct expr *)smalloc(sizeof **e);
-	if (wflag)
+		e0 = (*e) = aalloc(&patarena, sizeof **e);
+	if (wflag && !Fflag)
 		wcomp(&pat, &len);
 	(*e)->e_nxt = NULL;
 	(*e)->e_pat = pat;
+	(*e)->e_exp = NULL;
 	(*e)->e_len = len;
 	(*e)->e_flg = flg;
 }
@@ -96,18 +100,20 @@ void patstring(char *cp)
 }
 
 /*
- * Read patterns from file.
+ * Read patterns from file. The file is read into a single buffer at
+ * once and split in place; each pattern is terminated by a NUL byte
+ * replacing its newline.
  */
 void patfile(char *fn)
 {
 	struct stat st;
 	struct expr *e = NULL;
-	char *cp;
-	struct iblok *ip;
+	char *buf, *cp, *ep, *end;
 	size_t sz, len;
-	int nl;
+	ssize_t n;
+	int fd;
 
-	if ((ip = ib_open(fn, 0)) == NULL || fstat(ip->ib_fd, &st) < 0) {
+	if ((fd = open(fn, O_RDONLY)) < 0 || fstat(fd, &st) < 0) {
 		fprintf(stderr, "%s: can't open %s\n", progname, fn);
 		exit(2);
 	}
@@ -118,12 +124,69 @@ void patfile(char *fn)
 		else
 			e0 = NULL;
 	}
-	while (cp = NULL, sz = 0, (len = ib_getlin(ip, &cp, &sz, srealloc)) > 0) {
-		if ((nl = cp[len - 1] == '\n') != 0)
-			cp[len - 1] = '\0';
-		addpat(&e, cp, len - nl, nl);
+	sz = S_ISREG(st.st_mode) ? st.st_size + 2 : 4096;
+	buf = smalloc(sz);
+	len = 0;
+	while ((n = read(fd, &buf[len], sz - len - 1)) > 0)
+		if ((len += n) == sz - 1)
+			buf = srealloc(buf, sz *= 2);
+	close(fd);
+	end = &buf[len];
+	*end = '\0';
+	for (cp = buf; cp < end; cp = ep + 1) {
+		if ((ep = memchr(cp, '\n', end - cp)) == NULL) {
+			addpat(&e, cp, end - cp, 0);
+			break;
+		}
+		*ep = '\0';
+		addpat(&e, cp, ep - cp, E_NL);
+	}
+}
+
+/*
+ * Drop patterns that repeat earlier ones. Back-references are numbered
+ * across all patterns, so if there may be any, the list is left alone.
+ */
+void patnorm(void)
+{
+	static int done;
+	struct expr **htab, **hp, *e, *p;
+	const char *cp;
+	unsigned long h;
+	size_t hsize;
+	long n, ndup = 0;
+
+	if (done++ || e0 == NULL || e0->e_nxt == NULL)
+		return;
+	for (n = 0, e = e0; e; e = e->e_nxt, n++)
+		if (!Fflag)
+			for (cp = e->e_pat; cp < &e->e_pat[e->e_len] - 1; cp++)
+				if (cp[0] == '\\' && cp[1] >= '1' && cp[1] <= '9')
+					return;
+	for (hsize = 256; hsize < 2 * (size_t)n; hsize *= 2)
+		;
+	htab = scalloc(hsize, sizeof *htab);
+	for (p = NULL, e = e0; e; e = e->e_nxt) {
+		h = 2166136261UL;
+		for (cp = e->e_pat; cp < &e->e_pat[e->e_len]; cp++)
+			h = (h ^ (*cp & 0377)) * 16777619UL;
+		for (hp = &htab[h & (hsize - 1)]; *hp;
+				hp = hp < &htab[hsize - 1] ? &hp[1] : htab)
+			if ((*hp)->e_len == e->e_len &&
+			    memcmp((*hp)->e_pat, e->e_pat, e->e_len) == 0)
+				break;
+		if (*hp) {
+			p->e_nxt = e->e_nxt;
+			p->e_flg |= e->e_flg & E_NL;
+			ndup++;
+		} else {
+			*hp = e;
+			p = e;
+		}
 	}
-	ib_close(ip);
+	free(htab);
+	if (ndup)
+		explain("%ld duplicate pattern%s dropped", ndup, ndup > 1 ? "s" : "");
 }
 
 /*
@@ -181,12 +244,33 @@ int nextch(void)
 void outline(struct iblok *ip, char *last, size_t moff)
 {
 	register char *sol, *eol; /* start and end of line */
+	off_t soff;		  /* offset of the line */
 
 	if (qflag == 0) {
-		if (status == 1)
+		if (status == 1 && gapflag == 0)
 			status = 0;
 		if (lflag) {
 			puts(filename ? filename : stdinmsg);
+		} else if (cflag) {
+			/*
+			 * Only counted, so the start of the line is
+			 * not needed.
+			 */
+			lmatch++;
+			eol = memchr(ip->ib_cur + moff, '\n',
+					last + 1 - (ip->ib_cur + moff));
+			ip->ib_cur = eol + 1;
+		} else if (gapflag) {
+			/*
+			 * The line matched, so it ends the run of lines
+			 * selected by -v; without -v, the kernels stop
+			 * at the start of the line.
+			 */
+			lmatch++;
+			eol = memchr(ip->ib_cur + moff, '\n',
+					last + 1 - (ip->ib_cur + moff));
+			gapout(ip->ib_cur, eol + 1);
+			ip->ib_cur = eol + 1;
 		} else {
 			lmatch++;
 			sol = ip->ib_cur + moff;
@@ -199,10 +283,44 @@ void outline(struct iblok *ip, char *last, size_t moff)
 			ip->ib_cur += moff;
 			for (eol = ip->ib_cur; eol <= last && *eol != '\n'; eol++)
 				;
-			if (!cflag)
+			soff = ib_offs(ip) - 1 - (ip->ib_cur - sol);
+			if (oflag)
+				oreport(sol, eol - sol, soff);
+			else {
+				if (context)
+					ctxpre(ip, sol, soff);
 				report(sol, eol - sol, ib_offs(ip) / BSZ, 1);
+				if (context)
+					ctxpost(eol + 1, soff + (eol + 1 - sol));
+			}
 			ip->ib_cur = eol + 1;
 		}
 	} else /* qflag != 0 */
 		exit(0);
 }
+
+/*
+ * Count the newlines from s up to e, a word at a time: in a word xor'ed
+ * with newlines, the high bit of each byte that is zero is set by the
+ * expression below, and these bits are added up by the multiplication.
+ */
+size_t nlcount(const char *s, const char *e)
+{
+	const unsigned long ones = (unsigned long)-1 / 0377;
+	const unsigned long lo7 = ones * 0177, nl = ones * '\n';
+	unsigned long w;
+	size_t n = 0;
+
+	while (s < e && (size_t)s & (sizeof w - 1))
+		n += *s++ == '\n';
+	while (e - s >= (ptrdiff_t)sizeof w) {
+		memcpy(&w, s, sizeof w);
+		w ^= nl;
+		w = ~(((w & lo7) + lo7) | w | lo7);
+		n += (w >> 7) * ones >> (sizeof w - 1) * 8;
+		s += sizeof w;
+	}
+	while (s < e)
+		n += *s++ == '\n';
+	return n;
+}
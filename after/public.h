@@ -1,8 +1,44 @@
 #ifndef PUBLIC_H_
 #define PUBLIC_H_
 
+#include <stddef.h>
+
 extern char *progname; /* argv[0] to main() */
 
 int grep_run(int argc, char **argv);
 
-#endif
\ No newline at end of file
+/*
+ * Search library, see libgrep.c. A pattern set is compiled once and
+ * can then be searched by any number of threads, each with a scanner
+ * of its own.
+ */
+typedef struct grep_pat grep_pat;
+typedef struct grep_scan grep_scan;
+
+enum {
+	GREP_EXTENDED = 01, /* extended regular expressions, as -E */
+	GREP_FIXED = 02,    /* fixed strings, as -F */
+	GREP_ICASE = 04,    /* ignore case, as -i */
+	GREP_WORD = 010,    /* match words, as -w */
+	GREP_LINE = 020,    /* match entire lines, as -x */
+	GREP_INVERT = 040   /* select lines not matching, as -v */
+};
+
+/*
+ * Called for each selected line, without its newline; lineno counts
+ * from 1, offset is that of the start of the line. A nonzero return
+ * ends the search.
+ */
+typedef int (*grep_hit)(void *arg, const char *line, size_t len,
+		long long lineno, long long offset);
+
+grep_pat *grep_comp(const char *pats, size_t len, int flags, int *errp);
+size_t grep_error(int err, char *buf, size_t size);
+void grep_free(grep_pat *);
+grep_scan *grep_scan_new(const grep_pat *);
+void grep_scan_free(grep_scan *);
+long long grep_buf(grep_scan *, const char *, size_t, grep_hit, void *);
+long long grep_fd(grep_scan *, int, grep_hit, void *);
+long long grep_path(grep_scan *, const char *, grep_hit, void *);
+
+#endif
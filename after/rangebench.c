@@ -0,0 +1,221 @@
+/*
+ * grep - search a file for a pattern
+ *
+ * Gunnar Ritter, Freiburg i. Br., Germany, April 2001.
+ */
+/*
+ * Copyright (c) 2003 Gunnar Ritter
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute
+ * it freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+/*
+ * rangebench - time the range() kernel of a grep flavor in memory
+ *
+ * Linked with the objects of one flavor instead of its main(), so
+ * rangebench_sus, for example, searches with exactly the kernels of
+ * /usr/5bin/posix/grep. The options and pattern are set up as grep
+ * does, then range() is run over a copy of the whole file held in
+ * memory, several times, with output going to /dev/null. Reading
+ * and output formatting are thus left out, or nearly so with -c, and
+ * the timings are those of the inner loops alone.
+ */
+
+#include "alloc.h"
+#include "grep.h"
+#include "public.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * Cycles are counted with the time stamp counter where there is one;
+ * it runs at the nominal clock rate whatever the actual one.
+ */
+#if defined(__x86_64__) || defined(__i386__)
+#define	HAVE_TSC
+static unsigned long long tsc(void)
+{
+	unsigned int lo, hi;
+
+	__asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
+	return (unsigned long long)hi << 32 | lo;
+}
+#endif
+
+#define	PAD	64	/* kernels may look a little beyond the buffer */
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int cmpd(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void rbusage(const char *name)
+{
+	fprintf(stderr, "usage: %s [-n iterations] file name [option ...] "
+			"pattern\n", name);
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	char *self = argv[0], *fn, *buf, *copy;
+	struct iblok ib;
+	struct stat st;
+	FILE *out;
+	double t, t0, tbuild, *ns, *cyc;
+	size_t len;
+	ssize_t rd;
+	int c, fd, i, n = 10, stopped = 0;
+
+	while ((c = getopt(argc, argv, "+n:")) != EOF) {
+		switch (c) {
+		case 'n':
+			if ((n = atoi(optarg)) < 1)
+				rbusage(self);
+			break;
+		default:
+			rbusage(self);
+		}
+	}
+	if (argc - optind < 3)
+		rbusage(self);
+	fn = argv[optind++];
+	if ((fd = open(fn, O_RDONLY)) < 0 || fstat(fd, &st) < 0) {
+		fprintf(stderr, "%s: can't open %s\n", self, fn);
+		exit(2);
+	}
+	len = st.st_size;
+	buf = smalloc(len + PAD);
+	copy = smalloc(len + PAD);
+	for (i = 0; (size_t)i < len; i += rd)
+		if ((rd = read(fd, &buf[i], len - i)) <= 0) {
+			fprintf(stderr, "%s: read error on %s\n", self, fn);
+			exit(2);
+		}
+	close(fd);
+	/*
+	 * Only complete lines are passed to range().
+	 */
+	while (len > 0 && buf[len - 1] != '\n')
+		len--;
+	if (len == 0) {
+		fprintf(stderr, "%s: no complete line in %s\n", self, fn);
+		exit(2);
+	}
+	memset(&buf[len], 0, PAD);
+
+	/*
+	 * The remaining arguments are a grep command line.
+	 */
+	argc -= optind;
+	argv += optind;
+	optind = 1;
+	out = fdopen(dup(1), "w");
+	if (freopen("/dev/null", "w", stdout) == NULL) {
+		fprintf(stderr, "%s: can't open /dev/null\n", self);
+		exit(2);
+	}
+	t0 = now();
+	grep_setup(argc, argv);
+	tbuild = now() - t0;
+	if (optind != argc || lflag || qflag) {
+		fprintf(stderr, "%s: -l, -q, and file operands are not "
+				"supported\n", self);
+		exit(2);
+	}
+
+	ns = smalloc(n * sizeof *ns);
+	cyc = smalloc(n * sizeof *cyc);
+	memset(&ib, 0, sizeof ib);
+	ib.ib_fd = -1;
+	ib.ib_blk = copy;
+	ib.ib_blksize = len;
+	filename = fn;
+	for (i = 0; i < n; i++) {
+#ifdef HAVE_TSC
+		unsigned long long c0;
+#endif
+		/*
+		 * Kernels may write to the buffer, e.g. to NUL-terminate a
+		 * line, so every pass starts from a fresh copy.
+		 */
+		memcpy(copy, buf, len + PAD);
+		ib.ib_cur = copy;
+		ib.ib_end = &copy[len];
+		ib.ib_endoff = len;
+		lineno = lmatch = 0;
+		if (gapflag)
+			gapbase(&ib);
+		t0 = now();
+#ifdef HAVE_TSC
+		c0 = tsc();
+#endif
+		if (range(&ib, &copy[len - 1]))
+			stopped = 1;
+		if (gapflag)
+			gapout(&copy[len], &copy[len]);
+#ifdef HAVE_TSC
+		cyc[i] = (double)(tsc() - c0) / len;
+#else
+		cyc[i] = 0;
+#endif
+		t = now() - t0;
+		ns[i] = t * 1e9 / len;
+	}
+	fflush(stdout);
+	/*
+	 * With -v, the kernels may have counted the lines that match.
+	 */
+	if (cvflag || gapflag)
+		lmatch = lineno - lmatch;
+	qsort(ns, n, sizeof *ns, cmpd);
+	qsort(cyc, n, sizeof *cyc, cmpd);
+
+	fprintf(out, "{\"file\": \"%s\", \"bytes\": %lu, \"iterations\": %d, "
+			"\"lines\": %lld, \"matches\": %lld, "
+			"\"build_s\": %.6f, "
+			"\"ns_per_byte\": {\"min\": %.4f, \"median\": %.4f}, "
+#ifdef HAVE_TSC
+			"\"cycles_per_byte\": {\"min\": %.4f, \"median\": %.4f}, "
+#endif
+			"\"mb_s\": %.1f%s}\n",
+		fn, (unsigned long)len, n, (long long)lineno,
+		(long long)lmatch, tbuild, ns[0], ns[n / 2],
+#ifdef HAVE_TSC
+		cyc[0], cyc[n / 2],
+#endif
+		1e3 / ns[0], stopped ? ", \"stopped\": true" : "");
+	fclose(out);
+	return 0;
+}
@@ -40,10 +40,31 @@
 
 static int emptypat;
 
+/*
+ * For -o. The line being worked on is kept NUL-terminated in spbuf
+ * for regexec(); rvmark[i] is set where a match begins at line[i].
+ */
+static char *spbuf;
+static size_t spsize;
+#ifdef UXRE
+static regex_t *spexp; /* the patterns with REG_ONESUB */
+static regex_t *rvexp; /* the patterns reversed, from regrevcomp() */
+static char *rvmark;
+static size_t rvsize;
+#endif
+
+static int rc_spanre(const char *, size_t, size_t, size_t *, size_t *);
+
 #ifdef UXRE
 #include <regdfa.h>
 static int rc_range(struct iblok *, char *);
 static int rc_rangew(struct iblok *, char *);
+static int rc_rangex(struct iblok *, char *);
+static int rc_rangexw(struct iblok *, char *);
+static int rc_rangesa(struct iblok *, char *);
+static void rc_stats(void);
+static void rc_spanbuild(const char *, int);
+static int rc_span(const char *, size_t, size_t, size_t *, size_t *);
 #endif
 
 /*
@@ -65,8 +86,11 @@ static int rc_match(const char *str, size_t sz)
 			return 1;
 	}
 #ifdef UXRE
-	if (e0->e_exp)
+	if (e0->e_exp) {
+		if ((e0->e_exp->re_flags & REG_DFA) == 0)
+			gstats.gs_nfa++;
 		gotcha = (regexec(e0->e_exp, str, 1, pmatch, 0) == 0);
+	}
 #else  /* !UXRE */
 	for (e = e0; e; e = e->e_nxt) {
 		if (e->e_exp) {
@@ -84,6 +108,19 @@ static int rc_match(const char *str, size_t sz)
 	return 0;
 }
 
+/*
+ * Check whether the pattern list is better searched for as fixed
+ * strings, see gl_fixedset(). With -w, the patterns already carry
+ * \< \>.
+ */
+static int rc_literal(void)
+{
+	if (emptypat || e0->e_flg & E_NULL)
+		return 0;
+	return gl_fixedset(e0, (Eflag ? GREP_EXTENDED : 0) |
+			(iflag ? GREP_ICASE : 0) | (wflag ? GREP_WORD : 0));
+}
+
 /*
  * Compile a pattern structure using regcomp().
  */
@@ -96,7 +133,11 @@ static void rc_build(void)
 	char *pat, *cp;
 #endif /* UXRE */
 	struct expr *e;
+#ifdef UXRE
+	Sand *sp;
+#endif /* UXRE */
 
+	patnorm();
 	if ((e0->e_flg & E_NULL) == 0) {
 		for (sz = 0, e = e0; e; e = e->e_nxt) {
 			if (e->e_len > 0)
@@ -109,9 +150,16 @@ static void rc_build(void)
 	if ((e0->e_flg & E_NULL || emptypat) && sus == 0)
 		rc_error(e0, rerror);
 	if (sz == 0 || (emptypat && xflag == 0)) {
+		explain("empty pattern, every line matches");
 		e0->e_exp = NULL;
 		return;
 	}
+	if (rc_literal()) {
+		explain("patterns are fixed strings");
+		ac_select();
+		build();
+		return;
+	}
 #ifdef UXRE
 	pat = smalloc(sz);
 	for (cp = pat, e = e0; e; e = e->e_nxt) {
@@ -140,21 +188,42 @@ static void rc_build(void)
 	e->e_exp = (regex_t *)smalloc(sizeof *e->e_exp);
 	if ((rerror = regcomp(e->e_exp, pat, rflags)) != 0)
 		rc_error(e, rerror);
+	if (oflag && !xflag)
+		rc_spanbuild(pat, rflags);
 	free(pat);
-	if (!xflag && e->e_exp->re_flags & REG_DFA)
-		range = mbcode ? rc_rangew : rc_range;
+	if (e->e_exp->re_flags & REG_DFA) {
+		gstathook = rc_stats;
+		if (xflag == 0) {
+			if (mbcode == 0 && (sp = e->e_exp->re_dfa->sand) != NULL) {
+				range = rc_rangesa;
+				explain("Shift-And over %d column%s%s", sp->ncol,
+					sp->ncol > 1 ? "s" : "",
+					sp->opt | sp->rep ? ", some optional or repeated" : "");
+			} else {
+				range = mbcode ? rc_rangew : rc_range;
+				explain("lazy DFA");
+			}
+		} else if (emptypat == 0) {
+			range = mbcode ? rc_rangexw : rc_rangex;
+			explain("lazy DFA anchored at line start");
+		} else
+			explain("lazy DFA, line by line");
+	} else
+		explain("backtracking NFA, line by line");
 #else  /* !UXRE */
 	if (iflag)
 		rflags |= REG_ICASE;
 	if (Eflag)
 		rflags |= REG_EXTENDED;
-	if (!xflag)
+	if (!xflag && !oflag)
 		rflags |= REG_NOSUB;
 	for (e = e0; e; e = e->e_nxt) {
 		e->e_exp = (regex_t *)smalloc(sizeof *e->e_exp);
 		if ((rerror = regcomp(e->e_exp, e->e_pat, rflags)) != 0)
 			rc_error(e, rerror);
 	}
+	explain("regexec(), line by line");
+	span = rc_spanre;
 #endif /* !UXRE */
 }
 
@@ -166,6 +235,49 @@ void rc_select(void)
 	matchflags &= ~MF_LOCONV;
 }
 
+/*
+ * Find the leftmost longest match in line[off..sz) for -o with
+ * regexec(). A new line begins with off == 0.
+ */
+static int rc_spanre(const char *line, size_t sz, size_t off,
+		size_t *so, size_t *eo)
+{
+	regmatch_t pmatch[1];
+	int flags = off ? REG_NOTBOL : 0;
+#ifndef UXRE
+	struct expr *e;
+	int hit = 0;
+#endif
+
+	if (off == 0) {
+		if (sz + 1 > spsize)
+			spbuf = srealloc(spbuf, spsize = sz + 1);
+		memcpy(spbuf, line, sz);
+		spbuf[sz] = '\0';
+	}
+#ifdef UXRE
+	if (regexec(spexp, &spbuf[off], 1, pmatch, flags) != 0)
+		return 0;
+	*so = off + pmatch[0].rm_so;
+	*eo = off + pmatch[0].rm_eo;
+	return 1;
+#else  /* !UXRE */
+	for (e = e0; e; e = e->e_nxt) {
+		if (e->e_exp == NULL ||
+				regexec(e->e_exp, &spbuf[off], 1, pmatch, flags))
+			continue;
+		if (hit == 0 || off + pmatch[0].rm_so < *so ||
+				(off + pmatch[0].rm_so == *so &&
+				 off + pmatch[0].rm_eo > *eo)) {
+			*so = off + pmatch[0].rm_so;
+			*eo = off + pmatch[0].rm_eo;
+		}
+		hit = 1;
+	}
+	return hit;
+#endif /* !UXRE */
+}
+
 /*
  * Derived from Unix 32V /usr/src/cmd/egrep.y
  *
@@ -205,6 +317,178 @@ void rc_select(void)
  * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 #ifdef UXRE
+/*
+ * Compile what rc_span() needs for -o: the patterns with REG_ONESUB,
+ * so that the DFA can follow a match forward from where it begins, and
+ * reversed, to find where matches begin. Patterns the reversed DFA
+ * cannot take, such as those with \< \> or back-references, have their
+ * matches found by regexec() instead.
+ */
+static void rc_spanbuild(const char *pat, int rflags)
+{
+	int rerror;
+
+	rflags = (rflags & ~REG_NOSUB) | REG_ONESUB;
+	spexp = smalloc(sizeof *spexp);
+	if ((rerror = regcomp(spexp, pat, rflags)) != 0)
+		rc_error(e0, rerror);
+	rvexp = smalloc(sizeof *rvexp);
+	if (spexp->re_flags & REG_DFA &&
+			regrevcomp(rvexp, pat, rflags) == 0) {
+		span = rc_span;
+		explain("matches for -o by a reverse DFA pass over each line");
+	} else {
+		free(rvexp);
+		rvexp = NULL;
+		span = rc_spanre;
+		explain("matches for -o by regexec()");
+	}
+}
+
+/*
+ * Make a DFA transition from state st on wc; -1 is returned if
+ * the DFA cannot go on.
+ */
+static int rc_next(Dfa *dp, int st, wint_t wc)
+{
+	int nst;
+
+	if ((wc & ~(wchar_t)(NCHAR - 1)) != 0 || (nst = dp->trans[st][wc]) == 0)
+		nst = regtrans(dp, st, wc, mb_cur_max);
+	return nst - 1;
+}
+
+/*
+ * Get the character at p, before end, and its length.
+ */
+static int rc_char(const char *p, const char *end, wint_t *wc)
+{
+	int n;
+
+	if (mbcode && *p & 0200) {
+		if ((n = mbtowi(wc, p, end - p)) < 0) {
+			*wc = WEOF;
+			n = 1;
+		}
+	} else {
+		*wc = *p & 0377;
+		n = 1;
+	}
+	return n;
+}
+
+/*
+ * Mark in rvmark[] where matches begin in the line, by running the
+ * reverse DFA from the end of the line to its start. Being unanchored,
+ * it is in an accepting state wherever a match of the reversed pattern
+ * ends, which is where one of the pattern begins. A '\0' after the
+ * start of the line takes the place of '^', as it takes that of '$'
+ * at the end in the forward direction.
+ */
+static void rc_starts(const char *line, size_t sz)
+{
+	Dfa *dp = rvexp->re_dfa;
+	size_t i, k, *cp;
+	int st;
+	wint_t wc;
+
+	if (sz + 1 > rvsize)
+		rvmark = srealloc(rvmark, rvsize = sz + 1);
+	memset(rvmark, 0, sz + 1);
+	st = dp->anybol;
+	rvmark[sz] = dp->acc[st];
+	if (mbcode) {
+		/*
+		 * Characters are only known going forward; spbuf holds
+		 * their offsets.
+		 */
+		if ((sz + 1) * sizeof *cp > spsize)
+			spbuf = srealloc(spbuf, spsize = (sz + 1) * sizeof *cp);
+		cp = (size_t *)spbuf;
+		for (i = k = 0; k < sz; k += rc_char(&line[k], &line[sz], &wc))
+			cp[i++] = k;
+		while (i-- > 0) {
+			k = cp[i];
+			rc_char(&line[k], &line[sz], &wc);
+			if ((st = rc_next(dp, st, wc)) <= 0)
+				return;
+			rvmark[k] = dp->acc[st];
+		}
+	} else {
+		for (k = sz; k > 0; ) {
+			k--;
+			if ((st = rc_next(dp, st, line[k] & 0377)) <= 0)
+				return;
+			rvmark[k] = dp->acc[st];
+		}
+	}
+	if ((st = rc_next(dp, st, '\0')) > 0 && dp->acc[st])
+		rvmark[0] = 1;
+}
+
+/*
+ * Follow the match that begins at line[i] forward with the DFA
+ * started in its leftmost() state, and return where the longest one
+ * ends.
+ */
+static size_t rc_end(const char *line, size_t sz, size_t i)
+{
+	Dfa *dp = spexp->re_dfa;
+	size_t k, end = i;
+	int n, st;
+	wint_t wc;
+
+	st = i == 0 ? dp->leftbol : dp->leftmost;
+	for (k = i; k < sz; k += n) {
+		n = rc_char(&line[k], &line[sz], &wc);
+		if ((st = rc_next(dp, st, wc)) <= 0)
+			return end;
+		if (dp->acc[st])
+			end = k + n;
+	}
+	if ((st = rc_next(dp, st, '\0')) > 0 && dp->acc[st])
+		end = sz;
+	return end;
+}
+
+/*
+ * Find the leftmost longest match in line[off..sz) for -o; the
+ * reverse DFA pass is made when a new line begins with off == 0.
+ * As for regexec(), a NUL ends the line.
+ */
+static int rc_span(const char *line, size_t sz, size_t off,
+		size_t *so, size_t *eo)
+{
+	const char *nul;
+	size_t i;
+
+	if ((nul = memchr(line, '\0', sz)) != NULL)
+		sz = nul - line;
+	if (off > sz)
+		return 0;
+	if (off == 0)
+		rc_starts(line, sz);
+	for (i = off; rvmark[i] == 0; i++)
+		if (i == sz)
+			return 0;
+	*so = i;
+	*eo = rc_end(line, sz, i);
+	return 1;
+}
+
+/*
+ * Copy the counters of the DFA for -XX; they are kept in the
+ * automaton so that libuxre needs no global state.
+ */
+static void rc_stats(void)
+{
+	Dfa *dp = e0->e_exp->re_dfa;
+
+	gstats.gs_states = dp->nstates;
+	gstats.gs_flushes = dp->nflush;
+	gstats.gs_trans = dp->ntrans;
+}
+
 /*
  * Range search for singlebyte locales using the modified UNIX(R) Regular
  * Expression Library DFA.
@@ -242,7 +526,7 @@ static int rc_range(struct iblok *ip, char *last)
 				if (vflag == 0) {
 				succeed:
 					outline(ip, last, p - ip->ib_cur);
-					if (qflag || lflag)
+					if (enough)
 						return 1;
 				} else {
 				fail:
@@ -319,7 +603,7 @@ static int rc_rangew(struct iblok *ip, char *last)
 				if (vflag == 0) {
 				succeed:
 					outline(ip, last, p - ip->ib_cur);
-					if (qflag || lflag)
+					if (enough)
 						return 1;
 				} else {
 				fail:
@@ -349,4 +633,192 @@ static int rc_rangew(struct iblok *ip, char *last)
 	brk2:;
 	}
 }
+
+/*
+ * Range search for -x in singlebyte locales. The DFA is started in its
+ * leftmost() state without the leading STAR(ALL) at the beginning of each
+ * line, so it can only follow matches anchored there. A line matches if
+ * the state reached at the newline is accepting, either as it is or after
+ * the end-of-line transition (for patterns ending in '$'). Once the DFA
+ * dies, the rest of the line is skipped.
+ */
+static int rc_rangex(struct iblok *ip, char *last)
+{
+	char *p;
+	int c, cstat, nstat, hit;
+	Dfa *dp = e0->e_exp->re_dfa;
+
+	p = ip->ib_cur;
+	for (;;) {
+		lineno++;
+		cstat = dp->leftbol;
+		for (;;) {
+			if (*p == '\n' && dp->acc[cstat]) {
+				hit = 1;
+				break;
+			}
+			if ((nstat = dp->trans[cstat][*p & 0377]) == 0) {
+				if ((c = *p & 0377) == '\n')
+					c = '\0';
+				if ((nstat = regtrans(dp, cstat, c, 1)) == 0)
+					nstat = 1;
+				else
+					dp->trans[cstat]['\n'] = dp->trans[cstat]['\0'];
+			}
+			if ((cstat = nstat - 1) == 0 || *p == '\n') {
+				hit = dp->acc[cstat];
+				break;
+			}
+			p++;
+		}
+		if (hit ^ vflag) {
+			outline(ip, last, p - ip->ib_cur);
+			if (enough)
+				return 1;
+		} else {
+			while (*p != '\n')
+				p++;
+			ip->ib_cur = p + 1;
+		}
+		if ((p = ip->ib_cur) > last)
+			return 0;
+	}
+}
+
+/*
+ * Range search for -x in multibyte locales; see rc_rangex().
+ */
+static int rc_rangexw(struct iblok *ip, char *last)
+{
+	char *p;
+	int n, cstat, nstat, hit;
+	wint_t wc;
+	Dfa *dp = e0->e_exp->re_dfa;
+
+	p = ip->ib_cur;
+	for (;;) {
+		lineno++;
+		cstat = dp->leftbol;
+		for (;;) {
+			if (*p == '\n' && dp->acc[cstat]) {
+				hit = 1;
+				break;
+			}
+			if (*p & 0200) {
+				if ((n = mbtowi(&wc, p, last + 1 - p)) < 0) {
+					n = 1;
+					wc = WEOF;
+				}
+			} else {
+				wc = *p;
+				n = 1;
+			}
+			if ((wc & ~(wchar_t)(NCHAR - 1)) != 0 || (nstat = dp->trans[cstat][wc]) == 0) {
+				if (wc == '\n')
+					wc = '\0';
+				if ((nstat = regtrans(dp, cstat, wc, mb_cur_max)) == 0)
+					nstat = 1;
+				else
+					dp->trans[cstat]['\n'] = dp->trans[cstat]['\0'];
+			}
+			if ((cstat = nstat - 1) == 0 || *p == '\n') {
+				hit = dp->acc[cstat];
+				break;
+			}
+			p += n;
+		}
+		if (hit ^ vflag) {
+			outline(ip, last, p - ip->ib_cur);
+			if (enough)
+				return 1;
+		} else {
+			while (*p != '\n')
+				p++;
+			ip->ib_cur = p + 1;
+		}
+		if ((p = ip->ib_cur) > last)
+			return 0;
+	}
+}
+
+/*
+ * Pass over the lines from ip->ib_cur up to eol, none of which matched.
+ */
+static int rc_nohit(struct iblok *ip, char *last, char *eol)
+{
+	if (vflag == 0) {
+		lineno += nlcount(ip->ib_cur, eol);
+		ip->ib_cur = eol;
+		return 0;
+	}
+	while (ip->ib_cur < eol) {
+		lineno++;
+		outline(ip, last, 0);
+		if (enough)
+			return 1;
+	}
+	return 0;
+}
+
+/*
+ * Range search for singlebyte locales using the Shift-And form of the
+ * pattern built by libuxre. Since no column but those of '^' and '$'
+ * matches a newline, the whole buffer is scanned at once, without a
+ * test for line ends in the inner loop; the line of a match is located
+ * after it. Optional and repeated columns need a few more operations
+ * per byte and get a loop of their own. A NUL character ends the line
+ * for regexec(), so a match behind one is discarded.
+ */
+static int rc_rangesa(struct iblok *ip, char *last)
+{
+	const Sand *sp = e0->e_exp->re_dfa->sand;
+	register const unsigned long *mask = sp->mask;
+	register unsigned long d, df, acc = sp->acc;
+	register char *p;
+	unsigned long opt = sp->opt, rep = sp->rep;
+	unsigned long first = sp->first, fin = sp->last;
+	char *sol, *eol;
+	int hit;
+
+	p = ip->ib_cur;
+	d = sp->start;
+	for (;;) {
+		if ((opt | rep) == 0) {
+			while (p <= last) {
+				d = (d << 1 | 1) & mask[*p & 0377];
+				if (d & acc)
+					break;
+				p++;
+			}
+		} else {
+			while (p <= last) {
+				d = (d << 1 | 1 | (d & rep)) & mask[*p & 0377];
+				df = d | fin;
+				d |= opt & (~(df - first) ^ df);
+				if (d & acc)
+					break;
+				p++;
+			}
+		}
+		if (p > last)
+			return rc_nohit(ip, last, last + 1);
+		for (sol = p; sol > ip->ib_cur && sol[-1] != '\n'; sol--)
+			;
+		if (rc_nohit(ip, last, sol))
+			return 1;
+		for (eol = p; *eol != '\n'; eol++)
+			;
+		lineno++;
+		hit = memchr(sol, '\0', p - sol) == NULL;
+		if (hit ^ vflag) {
+			outline(ip, last, p - ip->ib_cur);
+			if (enough)
+				return 1;
+		} else
+			ip->ib_cur = eol + 1;
+		if ((p = ip->ib_cur) > last)
+			return 0;
+		d = sp->start;
+	}
+}
 #endif /* UXRE */
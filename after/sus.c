@@ -73,10 +73,15 @@ void usage(void)
 	else
 		sEF = "[-E|-F] ";
 	fprintf(stderr, "%s: Usage:\n\
-     %s[-c|-l%s] [-bhin%svx] pattern [file ...]\n\
-     %s[-c|-l%s] [-bhin%svx] -e pattern ... [-f file ...] [file ...]\n\
-     %s[-c|-l%s] [-bhin%svx] -f file ... [-e pattern ...] [file ...]\n",
-		progname, sEF, sq, ss, sEF, sq, ss, sEF, sq, ss);
+     [options] pattern [file ...]\n\
+     [options] -e pattern ... [-f file ...] [file ...]\n\
+     [options] -f file ... [-e pattern ...] [file ...]\n\
+Options:\n\
+     %s[-c|-l%s] [-bhinorR%svxX] [-m max] [-A num] [-B num] [-C num]\n\
+     [-S file] [-t] [--include=pattern] [--exclude=pattern]\n\
+     [--exclude-from=file] [--exclude-dir=pattern] [--ignore-file=name]\n\
+     [--stats]\n",
+		progname, sEF, sq, ss);
 	exit(2);
 }
 
@@ -103,16 +108,16 @@ void init(void)
 	case 'e':
 		Eflag = 2;
 		rc_select();
-		options = "EFbce:f:hilnqrRsvxyz";
+		options = "A:B:C:EFbce:f:hilm:noqrRS:stvxXyz";
 		break;
 	case 'f':
 		Fflag = 2;
 		ac_select();
-		options = "Fbce:f:hilnqrRsvxyz";
+		options = "A:B:C:Fbce:f:hilm:noqrRS:stvxXyz";
 		break;
 	default:
 		rc_select();
-		options = "EFbce:f:hilnqrRsvwxyz";
+		options = "A:B:C:EFbce:f:hilm:noqrRS:stvwxXyz";
 	}
 }
 
@@ -124,7 +129,9 @@ void st_select(void)
 {
 }
 
+#ifndef RANGEBENCH
 int main(int argc, char **argv)
 {
 	return grep_run(argc, argv);
-}
\ No newline at end of file
+}
+#endif /* !RANGEBENCH */
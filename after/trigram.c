@@ -0,0 +1,391 @@
+/*
+ * grep - search a file for a pattern
+ *
+ * Gunnar Ritter, Freiburg i. Br., Germany, April 2001.
+ */
+/*
+ * Copyright (c) 2003 Gunnar Ritter
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute
+ * it freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+/*
+ * Use of the trigram index made by grepidx, if GREP_INDEX names one.
+ *
+ * Every line that matches one of the patterns contains some strings
+ * that can be read off the pattern: the pattern itself with -F, and
+ * the runs of ordinary characters outside of groups, brackets, and
+ * repetitions in a regular expression. The trigrams of these strings
+ * must then occur in any file that has a match, and files that lack
+ * them are not searched. Anything that is not understood just ends a
+ * run, which can only make more files candidates; an alternation
+ * outside of a group, or a pattern without any trigram, means that
+ * every file is a candidate, and the index is not used.
+ */
+
+#include "alloc.h"
+#include "grep.h"
+#include "trigram.h"
+#include <ctype.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static int ixstate;		/* 1 if in use, -1 if not, 0 not yet decided */
+static struct ixhdr *ixh;
+static struct ixfile *ixf;
+static unsigned int *ixbyname;
+static struct ixtri *ixt;
+static char *ixnames;
+static unsigned int *ixpost;
+static unsigned char *ixcand;	/* candidate files, by bit */
+
+/*
+ * Trigrams required by one pattern.
+ */
+struct trset {
+	unsigned int *t_tri;
+	size_t t_n, t_max;
+};
+
+static void trrun(struct trset *ts, const char *s, size_t n)
+{
+	size_t i;
+
+	for (i = 0; i + 3 <= n; i++) {
+		if (iflag && (s[i] | s[i + 1] | s[i + 2]) & 0200)
+			continue;
+		if (ts->t_n == ts->t_max)
+			ts->t_tri = srealloc(ts->t_tri, (ts->t_max = ts->t_max ?
+					2 * ts->t_max : 64) * sizeof *ts->t_tri);
+		ts->t_tri[ts->t_n++] = TRI(s[i] & 0377, s[i + 1] & 0377,
+				s[i + 2] & 0377);
+	}
+}
+
+/*
+ * Skip a bracket expression; p is just past the [.
+ */
+static const char *skipbkt(const char *p, const char *end)
+{
+	int d;
+
+	if (p < end && *p == '^')
+		p++;
+	if (p < end && *p == ']')
+		p++;
+	while (p < end && *p != ']') {
+		if (*p == '[' && p + 1 < end &&
+				((d = p[1]) == ':' || d == '.' || d == '=')) {
+			for (p += 2; p + 1 < end && (p[0] != d || p[1] != ']'); p++)
+				;
+			p++;
+		}
+		p++;
+	}
+	return p < end ? p + 1 : end;
+}
+
+/*
+ * Skip a group; p is just past the opening parenthesis.
+ */
+static const char *skipgrp(const char *p, const char *end)
+{
+	int depth = 1;
+
+	while (p < end) {
+		if (*p == '[') {
+			p = skipbkt(p + 1, end);
+			continue;
+		}
+		if (*p == '\\' && p + 1 < end) {
+			if (Eflag == 0 && p[1] == '(')
+				depth++;
+			else if (Eflag == 0 && p[1] == ')' && --depth == 0)
+				return p + 2;
+			p += 2;
+			continue;
+		}
+		if (Eflag && *p == '(')
+			depth++;
+		else if (Eflag && *p == ')' && --depth == 0)
+			return p + 1;
+		p++;
+	}
+	return end;
+}
+
+/*
+ * Skip an interval; p is just past the opening brace.
+ */
+static const char *skipivl(const char *p, const char *end)
+{
+	while (p < end && *p != '}')
+		p++;
+	return p < end ? p + 1 : end;
+}
+
+/*
+ * Collect the trigrams of the strings any match of e contains. Returns
+ * 0 if nothing is known about them.
+ */
+static int patreq(struct expr *e, struct trset *ts)
+{
+	const char *p = e->e_pat, *end = &e->e_pat[e->e_len];
+	char *run;
+	size_t rn = 0, last = 0;
+	int c, n, ok = 1;
+
+	ts->t_n = 0;
+	if (Fflag) {
+		trrun(ts, p, e->e_len);
+		return ts->t_n > 0;
+	}
+	run = smalloc(e->e_len + 1);
+#define	flush()	(trrun(ts, run, rn), rn = last = 0)
+#define	drop()	(rn = last, flush())
+	while (p < end && ok) {
+		switch (c = *p) {
+		case '\\':
+			if (p + 1 >= end) {
+				flush();
+				p++;
+			} else if ((c = p[1]) & 0200)
+				p++;
+			else if (c == '|')
+				ok = 0;
+			else if (Eflag == 0 && c == '(') {
+				flush();
+				p = skipgrp(p + 2, end);
+			} else if (Eflag == 0 && c == '{') {
+				drop();
+				p = skipivl(p + 2, end);
+			} else if (strchr("(){}+?", c)) {
+				drop();
+				p += 2;
+			} else if (isalnum(c) || strchr("<>`'", c)) {
+				flush();
+				p += 2;
+			} else {
+				last = rn;
+				run[rn++] = c;
+				p += 2;
+			}
+			continue;
+		case '[':
+			flush();
+			p = skipbkt(p + 1, end);
+			continue;
+		case '.':
+		case '^':
+		case '$':
+			flush();
+			p++;
+			continue;
+		case '*':
+			drop();
+			p++;
+			continue;
+		}
+		if (Eflag && strchr("|()+?{", c)) {
+			if (c == '|')
+				ok = 0;
+			else if (c == '(') {
+				flush();
+				p = skipgrp(p + 1, end);
+			} else if (c == '{') {
+				drop();
+				p = skipivl(p + 1, end);
+			} else {
+				drop();
+				p++;
+			}
+			continue;
+		}
+		n = 1;
+		if (mbcode && c & 0200 && (n = mblen(p, end - p)) <= 0)
+			n = 1;
+		last = rn;
+		memcpy(&run[rn], p, n);
+		rn += n;
+		p += n;
+	}
+	if (ok)
+		flush();
+#undef	flush
+#undef	drop
+	free(run);
+	return ok && ts->t_n > 0;
+}
+
+static struct ixtri *trifind(unsigned int t)
+{
+	unsigned int lo = 0, hi = ixh->h_ntri, m;
+
+	while (lo < hi) {
+		m = (lo + hi) / 2;
+		if (ixt[m].t_tri < t)
+			lo = m + 1;
+		else if (ixt[m].t_tri > t)
+			hi = m;
+		else
+			return &ixt[m];
+	}
+	return NULL;
+}
+
+static int postfind(struct ixtri *tp, unsigned int f)
+{
+	unsigned int *lo = &ixpost[tp->t_post], *hi = &lo[tp->t_cnt], *m;
+
+	while (lo < hi) {
+		m = lo + (hi - lo) / 2;
+		if (*m < f)
+			lo = m + 1;
+		else if (*m > f)
+			hi = m;
+		else
+			return 1;
+	}
+	return 0;
+}
+
+/*
+ * Mark the files that contain all trigrams of ts as candidates.
+ */
+static void candidates(struct trset *ts)
+{
+	struct ixtri **tp, *sp = NULL;
+	unsigned int *fp, *fe;
+	size_t i, n;
+
+	tp = smalloc(ts->t_n * sizeof *tp);
+	for (i = n = 0; i < ts->t_n; i++) {
+		if ((tp[n] = trifind(ts->t_tri[i])) == NULL) {
+			free(tp);
+			return;
+		}
+		if (sp == NULL || tp[n]->t_cnt < sp->t_cnt)
+			sp = tp[n];
+		n++;
+	}
+	fe = &ixpost[sp->t_post + sp->t_cnt];
+	for (fp = &ixpost[sp->t_post]; fp < fe; fp++) {
+		for (i = 0; i < n; i++)
+			if (tp[i] != sp && !postfind(tp[i], *fp))
+				break;
+		if (i == n)
+			ixcand[*fp >> 3] |= 1 << (*fp & 7);
+	}
+	free(tp);
+}
+
+static void ix_init(void)
+{
+	struct stat st;
+	struct trset ts;
+	struct expr *e;
+	char *fn, *m;
+	unsigned int i, n;
+	int fd;
+
+	ixstate = -1;
+	if ((fn = getenv("GREP_INDEX")) == NULL || *fn == '\0' || vflag ||
+			cvflag || gapflag || zflag || e0 == NULL ||
+			e0->e_flg & E_NULL)
+		return;
+	if ((fd = open(fn, O_RDONLY)) < 0)
+		return;
+	if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof *ixh ||
+			(m = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0))
+				== MAP_FAILED) {
+		close(fd);
+		return;
+	}
+	close(fd);
+	ixh = (struct ixhdr *)m;
+	if (memcmp(ixh->h_magic, IXMAGIC, sizeof ixh->h_magic) ||
+			st.st_size != (off_t)(sizeof *ixh + ixh->h_nfile *
+				(sizeof *ixf + sizeof *ixbyname) +
+				ixh->h_ntri * sizeof *ixt + ixh->h_strsz +
+				ixh->h_npost * sizeof *ixpost)) {
+		explain("trigram index %s not usable", fn);
+		munmap(m, st.st_size);
+		return;
+	}
+	ixf = (struct ixfile *)&ixh[1];
+	ixbyname = (unsigned int *)&ixf[ixh->h_nfile];
+	ixt = (struct ixtri *)&ixbyname[ixh->h_nfile];
+	ixnames = (char *)&ixt[ixh->h_ntri];
+	ixpost = (unsigned int *)&ixnames[ixh->h_strsz];
+	ixcand = scalloc(ixh->h_nfile / 8 + 1, 1);
+	memset(&ts, 0, sizeof ts);
+	for (e = e0; e; e = e->e_nxt) {
+		if (!patreq(e, &ts)) {
+			explain("trigram index not used, no trigrams in a pattern");
+			free(ts.t_tri);
+			return;
+		}
+		candidates(&ts);
+	}
+	free(ts.t_tri);
+	for (i = n = 0; i < ixh->h_nfile; i++)
+		if (ixcand[i >> 3] & 1 << (i & 7))
+			n++;
+	explain("trigram index %s: %u of %u files are candidates", fn, n,
+		ixh->h_nfile);
+	ixstate = 1;
+}
+
+/*
+ * Whether the file fn is known to contain no match.
+ */
+int ix_skip(const char *fn)
+{
+	struct stat st;
+	struct ixfile *fp;
+	unsigned int lo, hi, m;
+	int d;
+
+	if (ixstate == 0)
+		ix_init();
+	if (ixstate < 0)
+		return 0;
+	for (lo = 0, hi = ixh->h_nfile; lo < hi; ) {
+		m = (lo + hi) / 2;
+		fp = &ixf[ixbyname[m]];
+		if (fp->f_name >= ixh->h_strsz)
+			return 0;
+		if ((d = strcmp(&ixnames[fp->f_name], fn)) < 0)
+			lo = m + 1;
+		else if (d > 0)
+			hi = m;
+		else {
+			if (stat(fn, &st) < 0 || st.st_mtime != fp->f_mtime ||
+					st.st_size != fp->f_size)
+				return 0;
+			m = ixbyname[m];
+			return (ixcand[m >> 3] & 1 << (m & 7)) == 0;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,75 @@
+/*
+ * grep - search a file for a pattern
+ *
+ * Gunnar Ritter, Freiburg i. Br., Germany, April 2001.
+ */
+/*
+ * Copyright (c) 2003 Gunnar Ritter
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute
+ * it freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+/*
+ * Trigram index of a file tree, built by grepidx and read by grep to
+ * skip files that cannot contain a match.
+ *
+ * A trigram is three consecutive bytes of a file, with ASCII capitals
+ * folded to lower case so that the index serves -i as well. The index
+ * file holds, in this order:
+ *
+ *	struct ixhdr
+ *	struct ixfile[h_nfile]		files in the order they were read
+ *	unsigned int[h_nfile]		their numbers, sorted by name
+ *	struct ixtri[h_ntri]		trigrams present, in ascending order
+ *	char[h_strsz]			file names, NUL-terminated
+ *	unsigned int[]			posting lists: ascending file numbers
+ *
+ * A file whose modification time or size no longer matches its entry
+ * is searched as if it were not in the index at all.
+ */
+#ifndef TRIGRAM_H_
+#define TRIGRAM_H_
+
+#define IXMAGIC "grepix1"
+
+struct ixhdr {
+	char h_magic[8];
+	unsigned int h_nfile;
+	unsigned int h_ntri;
+	unsigned long long h_strsz;
+	unsigned long long h_npost;
+};
+
+struct ixfile {
+	unsigned long long f_name;	/* offset in the name table */
+	long long f_mtime;
+	long long f_size;
+};
+
+struct ixtri {
+	unsigned int t_tri;
+	unsigned int t_cnt;		/* files containing it */
+	unsigned long long t_post;	/* first entry in the posting lists */
+};
+
+#define trifold(c)	((c) >= 'A' && (c) <= 'Z' ? (c) - 'A' + 'a' : (c))
+#define TRI(a, b, c)	((unsigned)trifold(a) << 16 | (unsigned)trifold(b) << 8 | \
+				(unsigned)trifold(c))
+
+#endif
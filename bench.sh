@@ -0,0 +1,284 @@
+#!/usr/bin/env bash
+# Throughput benchmarks for all grep flavors, written as JSON.
+# Usage:
+#   bash bench.sh [--bindir DIR] [--datadir DIR] [--outdir DIR] [--mb N]
+#                 [--runs N] [--filter REGEX] [--compare OLD.json]
+#                 [--threshold PCT]
+# Examples:
+#   bash bench.sh
+#   bash bench.sh --filter 'ascii' --runs 5
+#   bash bench.sh --compare out/bench-20261019-101500/results.json
+#
+# Each case is run --runs times on its corpus and on an empty file;
+# the fastest run of each is kept. Reported per case: wall, user and
+# system time, peak RSS, output lines, MB/s, output lines per second,
+# and the startup time on empty input (pattern compilation). With
+# --compare, the MB/s of cases present in both files are compared, and
+# the exit status is 1 if any got slower by more than --threshold
+# percent (default 10).
+set -euo pipefail
+
+# -------------------------------
+# Defaults / CLI parsing
+# -------------------------------
+BINDIR="./after"
+DATADIR="bench"
+OUTDIR=""
+MB="${BENCH_MB:-16}"
+RUNS=3
+FILTER=""
+COMPARE=""
+THRESHOLD=10
+
+while [[ $# -gt 0 ]]; do
+  case "$1" in
+    --bindir) BINDIR="${2:-}"; shift 2 ;;
+    --datadir) DATADIR="${2:-}"; shift 2 ;;
+    --outdir) OUTDIR="${2:-}"; shift 2 ;;
+    --mb) MB="${2:-}"; shift 2 ;;
+    --runs) RUNS="${2:-}"; shift 2 ;;
+    --filter) FILTER="${2:-}"; shift 2 ;;
+    --compare) COMPARE="${2:-}"; shift 2 ;;
+    --threshold) THRESHOLD="${2:-}"; shift 2 ;;
+    -h|--help)
+      sed -n '1,18p' "$0"
+      exit 0
+      ;;
+    *)
+      echo "[Error] Unknown option: $1"
+      exit 1
+      ;;
+  esac
+done
+
+if [[ -z "${OUTDIR}" ]]; then
+  ts=$(date +%Y%m%d-%H%M%S)
+  OUTDIR="out/bench-${ts}"
+fi
+
+# -------------------------------
+# Preconditions
+# -------------------------------
+for f in grep egrep fgrep grep_sus grep_su3; do
+  if [[ ! -x "$BINDIR/$f" ]]; then
+    echo "[Error] $BINDIR/$f is not executable. Build first or pass --bindir DIR."
+    exit 1
+  fi
+done
+command -v python3 >/dev/null || { echo "[Error] python3 is needed."; exit 1; }
+
+bash "$(dirname "$0")/gen-bench-files.sh" --dir "$DATADIR" --mb "$MB"
+mkdir -p "$OUTDIR"
+
+RESULTS="$OUTDIR/results.jsonl"
+: > "$RESULTS"
+
+# -------------------------------
+# Helpers
+# -------------------------------
+locale_for() {
+  # The UTF-8 corpus is searched in a UTF-8 locale, the others in C.
+  case "$1" in
+    utf8.txt) echo "C.UTF-8" ;;
+    *) echo "C" ;;
+  esac
+}
+
+bench() {
+  # Args:
+  #   $1: corpus file name in $DATADIR
+  #   "${@:2}": flavor and arguments; "@name" names a file in $DATADIR
+  local corpus="$1"; shift
+  local flavor="$1"; shift
+  local args=() a name
+  name="$flavor"
+  for a in "$@"; do
+    if [[ "$a" == @* ]]; then
+      args+=("$DATADIR/${a#@}")
+      name+=" ${a#@}"
+    else
+      args+=("$a")
+      name+=" $a"
+    fi
+  done
+  name+=" $corpus"
+  if [[ -n "$FILTER" ]] && ! [[ "$name" =~ $FILTER ]]; then
+    return 0
+  fi
+  LC_ALL="$(locale_for "$corpus")" python3 - "$name" "$RUNS" \
+    "$DATADIR/$corpus" "$BINDIR/$flavor" "${args[@]}" >>"$RESULTS" <<'PY'
+import json
+import os
+import sys
+import time
+
+name, runs, corpus, cmd = sys.argv[1], int(sys.argv[2]), sys.argv[3], sys.argv[4:]
+
+def once(path):
+    """Run cmd on path; return (wall, user, sys, maxrss, lines, status)."""
+    rd, wr = os.pipe()
+    t0 = time.perf_counter()
+    pid = os.fork()
+    if pid == 0:
+        os.dup2(wr, 1)
+        os.close(rd)
+        os.close(wr)
+        devnull = os.open("/dev/null", os.O_WRONLY)
+        os.dup2(devnull, 2)
+        try:
+            os.execv(cmd[0], cmd + [path])
+        finally:
+            os._exit(127)
+    os.close(wr)
+    lines = 0
+    while True:
+        buf = os.read(rd, 1 << 16)
+        if not buf:
+            break
+        lines += buf.count(b"\n")
+    os.close(rd)
+    _, st, ru = os.wait4(pid, 0)
+    wall = time.perf_counter() - t0
+    return wall, ru.ru_utime, ru.ru_stime, ru.ru_maxrss, lines, \
+        os.waitstatus_to_exitcode(st) if hasattr(os, "waitstatus_to_exitcode") \
+        else st >> 8
+
+best = min((once(corpus) for _ in range(runs)), key=lambda r: r[0])
+start = min(once("/dev/null")[0] for _ in range(runs))
+size = os.path.getsize(corpus)
+wall = best[0]
+print(json.dumps({
+    "name": name,
+    "flavor": os.path.basename(cmd[0]),
+    "args": cmd[1:],
+    "corpus": os.path.basename(corpus),
+    "locale": os.environ.get("LC_ALL", ""),
+    "bytes": size,
+    "status": best[5],
+    "lines": best[4],
+    "wall_s": round(wall, 6),
+    "user_s": round(best[1], 6),
+    "sys_s": round(best[2], 6),
+    "startup_s": round(start, 6),
+    "maxrss_kb": best[3],
+    "mb_s": round(size / 1e6 / wall, 3),
+    "lines_s": round(best[4] / wall, 1),
+}, sort_keys=True))
+PY
+  tail -n 1 "$RESULTS" | python3 -c '
+import json, sys
+r = json.loads(sys.stdin.read())
+print("[Bench] %-48s %9.1f MB/s %8d KB %8.4f s start%s" % (r["name"],
+      r["mb_s"], r["maxrss_kb"], r["startup_s"],
+      "" if r["status"] < 2 else "  (exit %d)" % r["status"]))'
+}
+
+# -------------------------------
+# Benchmark Plan
+# -------------------------------
+echo "[Info] Output directory: $OUTDIR"
+echo "[Info] Binaries: $BINDIR"
+echo "[Info] Runs per case: $RUNS"
+
+BRE='user1[0-9]*7@host'
+
+# 1) Every flavor with the options all of them accept, on every corpus
+for corpus in ascii.log utf8.txt json.txt binary.bin; do
+  for opts in "" "-c" "-i" "-n" "-v -c"; do
+    # shellcheck disable=SC2086
+    {
+      bench "$corpus" grep $opts "$BRE"
+      bench "$corpus" egrep $opts -f @re10
+      bench "$corpus" fgrep $opts -f @lit10
+      for sus in grep_sus grep_su3; do
+        bench "$corpus" $sus $opts -e "$BRE"
+        bench "$corpus" $sus -E $opts -f @re10
+        bench "$corpus" $sus -F $opts -f @lit10
+      done
+    }
+  done
+  # Options only some flavors have
+  bench "$corpus" grep -w "$BRE"
+  bench "$corpus" fgrep -x -f @lit10
+  bench "$corpus" grep_sus -w -e "$BRE"
+  bench "$corpus" grep_sus -F -x -f @lit10
+done
+
+# 2) Growing pattern sets
+for set in lit1 lit1k lit100k lit1m; do
+  bench ascii.log fgrep -c -f @$set
+  bench ascii.log grep_sus -F -c -f @$set
+  bench ascii.log grep_sus -F -i -c -f @$set
+done
+bench ascii.log egrep -c -f @re1
+bench ascii.log grep_sus -E -c -f @re1
+for set in re100 re1k; do
+  bench ascii-1m.log egrep -c -f @$set
+  bench ascii-1m.log grep_sus -E -c -f @$set
+done
+
+# -------------------------------
+# Results
+# -------------------------------
+python3 - "$RESULTS" "$OUTDIR/results.json" "$BINDIR" "$MB" <<'PY'
+import json
+import platform
+import subprocess
+import sys
+import time
+
+src, dst, bindir, mb = sys.argv[1:5]
+try:
+    commit = subprocess.run(["git", "rev-parse", "--short", "HEAD"],
+                            capture_output=True, text=True).stdout.strip()
+except OSError:
+    commit = ""
+with open(src) as f:
+    results = [json.loads(l) for l in f if l.strip()]
+with open(dst, "w") as f:
+    json.dump({
+        "commit": commit,
+        "date": time.strftime("%Y-%m-%dT%H:%M:%S"),
+        "host": platform.node(),
+        "machine": platform.machine(),
+        "corpus_mb": int(mb),
+        "bindir": bindir,
+        "results": results,
+    }, f, indent=1, sort_keys=True)
+    f.write("\n")
+PY
+echo "[Info] Results: $OUTDIR/results.json"
+
+if [[ -n "$COMPARE" ]]; then
+  python3 - "$COMPARE" "$OUTDIR/results.json" "$THRESHOLD" <<'PY'
+import json
+import sys
+
+old, new, pct = sys.argv[1], sys.argv[2], float(sys.argv[3])
+with open(old) as f:
+    o = json.load(f)
+with open(new) as f:
+    n = json.load(f)
+if o.get("corpus_mb") != n.get("corpus_mb"):
+    print("[Warn] corpus sizes differ: %s MB vs %s MB" %
+          (o.get("corpus_mb"), n.get("corpus_mb")))
+prev = {r["name"]: r for r in o["results"]}
+bad = 0
+for r in n["results"]:
+    p = prev.get(r["name"])
+    if p is None or p["mb_s"] <= 0:
+        continue
+    ratio = r["mb_s"] / p["mb_s"]
+    flag = ""
+    if ratio < 1 - pct / 100:
+        flag = "  SLOWER"
+        bad += 1
+    elif ratio > 1 + pct / 100:
+        flag = "  faster"
+    print("[Compare] %-48s %9.1f -> %9.1f MB/s %6.2fx%s" %
+          (r["name"], p["mb_s"], r["mb_s"], ratio, flag))
+print("[Compare] %s (%s) vs %s (%s): %d case(s) slower by more than %g%%" %
+      (o.get("commit"), old, n.get("commit"), new, bad, pct))
+sys.exit(1 if bad else 0)
+PY
+fi
@@ -0,0 +1,144 @@
+#!/usr/bin/env bash
+# Generate the corpora and pattern sets used by bench.sh.
+# Usage:
+#   bash gen-bench-files.sh [--dir DIR] [--mb N]
+# The same arguments always produce the same files, byte for byte, so
+# results from different commits or machines can be compared.
+set -euo pipefail
+
+DIR="bench"
+MB="${BENCH_MB:-16}"
+
+while [[ $# -gt 0 ]]; do
+  case "$1" in
+    --dir) DIR="${2:-}"; shift 2 ;;
+    --mb) MB="${2:-}"; shift 2 ;;
+    -h|--help)
+      sed -n '1,6p' "$0"
+      exit 0
+      ;;
+    *)
+      echo "[Error] Unknown option: $1"
+      exit 1
+      ;;
+  esac
+done
+
+mkdir -p "$DIR"
+
+# Skip the work if the corpora for this size are already there.
+if [[ -f "$DIR/.stamp" && "$(cat "$DIR/.stamp")" == "$MB" ]]; then
+  exit 0
+fi
+
+echo "[Info] Generating ${MB} MB corpora in $DIR"
+
+python3 - "$DIR" "$MB" <<'PY'
+import random
+import sys
+
+out, mb = sys.argv[1], int(sys.argv[2])
+size = mb << 20
+# Only random() is used: its sequence for a given seed is stable
+# across Python versions, unlike randrange() and choice().
+rnd = random.Random(20261019).random
+
+def pick(seq):
+    return seq[int(rnd() * len(seq))]
+
+def num(n):
+    return int(rnd() * n)
+
+levels = ["INFO", "INFO", "INFO", "DEBUG", "WARN", "ERROR"]
+comps = ["http", "db", "cache", "auth", "queue", "scheduler", "mailer"]
+words = ["request", "served", "in", "ms", "connection", "reset", "by",
+         "peer", "retrying", "timeout", "user", "logged", "out", "token",
+         "expired", "cache", "miss", "for", "key", "query", "took",
+         "rows", "returned", "job", "finished", "with", "status"]
+
+# 1) ascii.log: web service log lines
+with open(out + "/ascii.log", "w") as f:
+    n = 0
+    while n < size:
+        line = "2026-10-%02d %02d:%02d:%02d %s %s: %s id=%d user%d@host%d\n" % (
+            1 + num(28), num(24), num(60), num(60), pick(levels),
+            pick(comps), " ".join(pick(words) for _ in range(3 + num(8))),
+            num(1000000), num(100000), num(64))
+        f.write(line)
+        n += len(line)
+
+# 1a) ascii-1m.log: its first megabyte, for the slowest cases
+with open(out + "/ascii.log") as f, open(out + "/ascii-1m.log", "w") as g:
+    n = 0
+    for line in f:
+        if n + len(line) > 1 << 20:
+            break
+        g.write(line)
+        n += len(line)
+
+# 2) utf8.txt: prose in several scripts
+uwords = ["서울", "부산", "테스트", "검색", "grüße", "straße", "café",
+          "naïve", "Ærø", "Ωmega", "σοφία", "Москва", "данные", "東京",
+          "検索", "文字列", "🙂", "😎", "foo", "bar", "grep", "line"]
+with open(out + "/utf8.txt", "w", encoding="utf-8") as f:
+    n = 0
+    while n < size:
+        line = " ".join(pick(uwords) for _ in range(4 + num(12))) + "\n"
+        f.write(line)
+        n += len(line.encode("utf-8"))
+
+# 3) json.txt: one large JSON document per line
+with open(out + "/json.txt", "w") as f:
+    n = 0
+    while n < size:
+        tags = ",".join('"%s%d"' % (pick(words), num(1000))
+                        for _ in range(2000 + num(4000)))
+        line = '{"id":%d,"user":"user%d@host%d","tags":[%s]}\n' % (
+            num(1000000), num(100000), num(64), tags)
+        f.write(line)
+        n += len(line)
+
+# 4) binary.bin: bytes of every value, with NULs and few newlines
+with open(out + "/binary.bin", "wb") as f:
+    n = 0
+    while n < size:
+        blk = bytes(num(256) for _ in range(4096))
+        if num(4) == 0:
+            blk += b"user%d@host" % num(100000)
+        f.write(blk)
+        n += len(blk)
+
+# 5) Literal pattern sets: lit1 ... lit1m
+def literal():
+    k = num(3)
+    if k == 0:
+        return "user%d@" % num(100000)
+    if k == 1:
+        return "id=%d " % num(1000000)
+    return "%s %s" % (pick(words), pick(words))
+
+for name, cnt in (("lit1", 1), ("lit10", 10), ("lit1k", 1000),
+                  ("lit100k", 100000), ("lit1m", 1000000)):
+    with open(out + "/" + name, "w") as f:
+        for _ in range(cnt):
+            f.write(literal() + "\n")
+
+# 6) Extended regular expression sets: re1 ... re1k
+def regex():
+    k = num(4)
+    if k == 0:
+        return "user%d[0-9]*@host" % num(1000)
+    if k == 1:
+        return "id=%d(0|5)+ " % num(10000)
+    if k == 2:
+        return "(%s|%s) %s" % (pick(words), pick(words), pick(words))
+    return "%s: .*%s" % (pick(comps), pick(words))
+
+for name, cnt in (("re1", 1), ("re10", 10), ("re100", 100),
+                  ("re1k", 1000)):
+    with open(out + "/" + name, "w") as f:
+        for _ in range(cnt):
+            f.write(regex() + "\n")
+PY
+
+echo "$MB" > "$DIR/.stamp"
@@ -88,6 +88,40 @@ PY
 # 9) no_newline.txt: 마지막 줄 개행 없음 처리 확인
 printf "last line without newline with foo" > tests/no_newline.txt
 
+# 10) refill.txt: 입력 버퍼(블록 크기, 보통 4 KB) 재충전 경계를 가로지르는 줄들,
+#     -A/-B/-C 와 -m 의 문맥 출력 확인
+python3 - <<'PY'
+lines = []
+for i in range(1, 601):
+    fill = "x" * (i * 37 % 113)
+    if i % 23 == 0:
+        lines.append("line %d: foo %s foo" % (i, fill))
+    else:
+        lines.append("line %d: %s" % (i, fill))
+    if i == 300:
+        lines.append("C" * 4000 + " foo " + "D" * 9000)
+with open("tests/refill.txt", "w", encoding="utf-8") as f:
+    f.write("\n".join(lines) + "\n")
+PY
+
+# 11) tree/: -r 과 --include/--exclude/--exclude-dir 확인용 디렉터리
+rm -rf tests/tree
+mkdir -p tests/tree/sub tests/tree/skip
+echo "foo in a.c" > tests/tree/a.c
+echo "foo in a.h" > tests/tree/a.h
+echo "foo in sub/b.c" > tests/tree/sub/b.c
+echo "foo in sub/b.h" > tests/tree/sub/b.h
+echo "foo in skip/c.c" > tests/tree/skip/c.c
+
+# 12) ign/: --ignore-file 확인용 디렉터리 (부정 '!', 앵커 '/', 디렉터리 전용 '/' 규칙)
+rm -rf tests/ign
+mkdir -p tests/ign/sub tests/ign/build
+printf '*.log\n!keep.log\n/top.txt\nbuild/\n' > tests/ign/.gitignore
+printf '# 상위 규칙을 뒤집음\n!y.log\n' > tests/ign/sub/.gitignore
+for f in a.txt x.log keep.log top.txt sub/top.txt sub/y.log sub/keep.log build/b.txt; do
+  echo "foo in $f" > "tests/ign/$f"
+done
+
 # 샘플 패턴 안내 파일(읽기 전용)
 cat > tests/README_patterns.txt <<'EOF'
 추천 테스트 패턴/옵션 (patterns & options)
@@ -1,7 +1,11 @@
 #!/usr/bin/env bash
 # Minimal smoke tests for grep with optional valgrind and per-test artifacts.
 # Usage:
-#   bash smoke-test.sh [--valgrind] [--outdir DIR] [--grep PATH] [--sys-grep PATH]
+#   bash smoke-test.sh [--valgrind] [--outdir DIR] [--grep PATH] [--grep-sus PATH]
+#                      [--sys-grep PATH]
+# The POSIX grep (--grep-sus) runs the options the traditional grep lacks.
+# It defaults to grep_sus next to --grep, where grepd, grepc and grepidx
+# are taken from.
 # Examples:
 #   bash smoke-test.sh
 #   bash smoke-test.sh --valgrind
@@ -14,6 +18,7 @@ set -euo pipefail
 VALGRIND=0
 OUTDIR=""
 G="${G:-./grep}"
+GS="${GS:-}"
 SYS_GREP="${SYS_GREP:-/bin/grep}"
 VALGRIND_OPTS="${VALGRIND_OPTS:---leak-check=full --show-leak-kinds=all --errors-for-leak-kinds=definite --error-exitcode=99}"
 
@@ -22,9 +27,10 @@ while [[ $# -gt 0 ]]; do
     --valgrind) VALGRIND=1; shift ;;
     --outdir) OUTDIR="${2:-}"; shift 2 ;;
     --grep) G="${2:-}"; shift 2 ;;
+    --grep-sus) GS="${2:-}"; shift 2 ;;
     --sys-grep) SYS_GREP="${2:-}"; shift 2 ;;
     -h|--help)
-      sed -n '1,35p' "$0"
+      sed -n '1,12p' "$0"
       exit 0
       ;;
     *)
@@ -34,6 +40,12 @@ while [[ $# -gt 0 ]]; do
   esac
 done
 
+BINDIR="$(dirname "$G")"
+GS="${GS:-$BINDIR/grep_sus}"
+GD="$BINDIR/grepd"
+GC="$BINDIR/grepc"
+GI="$BINDIR/grepidx"
+
 if [[ -z "${OUTDIR}" ]]; then
   ts=$(date +%Y%m%d-%H%M%S)
   OUTDIR="out/smoke-${ts}"
@@ -46,17 +58,26 @@ if [[ ! -x "$G" ]]; then
   echo "[Error] $G is not executable. Build your grep or pass --grep PATH."
   exit 1
 fi
+for b in "$GS" "$GD" "$GC" "$GI"; do
+  if [[ ! -x "$b" ]]; then
+    echo "[Error] $b is not executable. Build it next to $G."
+    exit 1
+  fi
+done
 if [[ ! -x "$SYS_GREP" ]]; then
   echo "[Error] System grep ($SYS_GREP) not found or not executable. Pass --sys-grep PATH."
   exit 1
 fi
 
-need_files=(tests/small.txt tests/multi.txt tests/case.txt tests/longline.txt tests/no_newline.txt)
+need_files=(tests/small.txt tests/multi.txt tests/case.txt tests/longline.txt tests/no_newline.txt
+            tests/edge.txt tests/refill.txt tests/tree/a.c
+            tests/ign/.gitignore)
 for f in "${need_files[@]}"; do
   [[ -f "$f" ]] || { echo "[Error] Missing: $f"; exit 1; }
 done
 
 mkdir -p "$OUTDIR"
+FAILED=0
 
 # -------------------------------
 # Helpers
@@ -79,8 +100,8 @@ run_with_capture() {
 
   # Disable immediate exit for this block to capture non-zero exit codes
   set +e
-  if [[ $VALGRIND -eq 1 && "$1" == "$G" ]]; then
-    # Wrap only the local grep under test
+  if [[ $VALGRIND -eq 1 && "$1" != "$SYS_GREP" ]]; then
+    # Wrap only the local programs under test
     valgrind $VALGRIND_OPTS --log-file="$vglog" "$@" >"$stdout" 2>"$stderr"
   else
     "$@" >"$stdout" 2>"$stderr"
@@ -93,7 +114,7 @@ check() {
   # Compare stdout of local grep vs system grep for a given test case.
   # Args:
   #   $1: human-readable test name
-  #   "${@:2}": command line with $G as the first element
+  #   "${@:2}": command line with a local program as the first element
   local name="$1"; shift
   local slug; slug="$(slugify "$name")"
   local base_local="${OUTDIR}/${slug}_local"
@@ -111,7 +132,8 @@ check() {
   if ! diff -u "${base_sys}.stdout" "${base_local}.stdout" >"${base_diff}.diff_stdout" ; then
     echo "[Fail] $name - stdout mismatch"
     echo "See: ${base_diff}.diff_stdout"
-    exit 1
+    FAILED=$((FAILED + 1))
+    return
   fi
 
   echo "[Pass] $name"
@@ -134,8 +156,53 @@ assert_match() {
   else
     echo "[Fail] $name - expected success (match), got exit code $rc"
     echo "See: ${base_local}.stdout, ${base_local}.stderr"
-    exit 1
+    FAILED=$((FAILED + 1))
+  fi
+}
+
+expect() {
+  # Compare stdout of a local program with the expected lines, for cases
+  # the system grep cannot run. The lines are compared sorted, as -r
+  # lists files in directory order.
+  # Args:
+  #   $1: human-readable test name
+  #   $2: expected lines, separated by newlines
+  #   "${@:3}": command line with a local program as the first element
+  local name="$1" want="$2"; shift 2
+  local slug; slug="$(slugify "$name")"
+  local base_local="${OUTDIR}/${slug}_local"
+  local base_diff="${OUTDIR}/${slug}"
+
+  run_with_capture "$base_local" "$@"
+  if [[ -n "$want" ]]; then
+    printf '%s\n' "$want" | sort >"${base_diff}.expected"
+  else
+    : >"${base_diff}.expected"
+  fi
+  if ! sort "${base_local}.stdout" | diff -u "${base_diff}.expected" - >"${base_diff}.diff_stdout" ; then
+    echo "[Fail] $name - stdout mismatch"
+    echo "See: ${base_diff}.diff_stdout"
+    FAILED=$((FAILED + 1))
+    return
   fi
+
+  echo "[Pass] $name"
+}
+
+start_grepd() {
+  # Run grepd on a socket in the output directory until the script exits.
+  GREP_SERVER="${OUTDIR}/grepd.sock"
+  export GREP_SERVER
+  "$GD" "$GREP_SERVER" 2>"${OUTDIR}/grepd.stderr" &
+  GD_PID=$!
+  trap 'kill "$GD_PID" 2>/dev/null' EXIT
+  for _ in $(seq 50); do
+    [[ -S "$GREP_SERVER" ]] && return 0
+    sleep 0.1
+  done
+  echo "[Fail] grepd did not start; see ${OUTDIR}/grepd.stderr"
+  FAILED=$((FAILED + 1))
+  return 1
 }
 
 # -------------------------------
@@ -143,6 +210,7 @@ assert_match() {
 # -------------------------------
 echo "[Info] Output directory: $OUTDIR"
 echo "[Info] Local grep: $G"
+echo "[Info] Local POSIX grep: $GS"
 echo "[Info] System grep: $SYS_GREP"
 echo "[Info] Valgrind: $([[ $VALGRIND -eq 1 ]] && echo ON || echo OFF)"
 
@@ -167,4 +235,120 @@ check "no newline at EOF"   "$G" "foo" tests/no_newline.txt
 # 7) Very long line handling (buffer boundary check) - existence check only
 assert_match "long line handling (-q)" "$G" -q "foo" tests/longline.txt
 
+# 8) Searches done by grepd for grepc
+if start_grepd; then
+  check "grepc basic"       "$GC" "foo" tests/small.txt
+  check "grepc -n files"    "$GC" -n "foo" tests/small.txt tests/multi.txt
+  check "grepc -c -v"       "$GC" -c -v "foo" tests/small.txt tests/multi.txt
+  check "grepc -i -w"       "$GC" -i -w "foo" tests/case.txt tests/multi.txt
+  check "grepc repeated"    "$GC" -n "foo" tests/small.txt tests/multi.txt
+fi
+
+# 9) Files skipped with a trigram index; a file grown since is searched
+cp tests/edge.txt "${OUTDIR}/grown.txt"
+if "$GI" -o "${OUTDIR}/index" tests/small.txt tests/multi.txt tests/edge.txt \
+    "${OUTDIR}/grown.txt" >"${OUTDIR}/grepidx.stderr" 2>&1; then
+  echo "foo added" >>"${OUTDIR}/grown.txt"
+  GREP_INDEX="${OUTDIR}/index" \
+    check "-c with an index" "$G" -c "foo" tests/small.txt tests/edge.txt \
+      tests/multi.txt "${OUTDIR}/grown.txt"
+  GREP_INDEX="${OUTDIR}/index" \
+    check "-l with an index" "$G" -l "foo" tests/small.txt tests/edge.txt \
+      tests/multi.txt "${OUTDIR}/grown.txt"
+else
+  echo "[Fail] grepidx - see ${OUTDIR}/grepidx.stderr"
+  FAILED=$((FAILED + 1))
+fi
+
+# 10) Incremental searches with -S: appended lines, a last line without
+#     its newline, and a truncated file
+SLOG="${OUTDIR}/growing.log"
+SSTATE="${OUTDIR}/growing.state"
+printf 'foo 1\nbar\n' >"$SLOG"
+expect "-S first run"       "1:foo 1" "$GS" -n -S "$SSTATE" "foo" "$SLOG"
+printf 'foo 3\nfoo partial' >>"$SLOG"
+expect "-S appended lines"  "3:foo 3" "$GS" -n -S "$SSTATE" "foo" "$SLOG"
+printf '\nfoo 5\n' >>"$SLOG"
+expect "-S partial line"    $'4:foo partial\n5:foo 5' \
+                            "$GS" -n -S "$SSTATE" "foo" "$SLOG"
+expect "-S nothing new"     "" "$GS" -n -S "$SSTATE" "foo" "$SLOG"
+printf 'foo new\n' >"$SLOG"
+expect "-S truncated file"  "1:foo new" "$GS" -n -S "$SSTATE" "foo" "$SLOG"
+
+# 11) Stop after max selected lines (-m)
+check "-m max count"        "$GS" -m 2 "foo" tests/multi.txt
+check "-m -n multi-file"    "$GS" -m 1 -n "foo" tests/small.txt tests/multi.txt
+check "-m -c"               "$GS" -m 2 -c "foo" tests/small.txt tests/multi.txt
+check "-m -v"               "$GS" -m 2 -v "foo" tests/multi.txt
+check "-m 0"                "$GS" -m 0 "foo" tests/small.txt
+check "-m traditional"      "$G" -m 1 -n "foo" tests/small.txt tests/multi.txt
+
+# 12) Only the matching part of each line (-o)
+check "-o only matching"    "$GS" -o "fo*" tests/multi.txt
+check "-o -n multi-file"    "$GS" -on "foo" tests/small.txt tests/multi.txt
+check "-o -i"               "$GS" -oi "foo" tests/case.txt
+check "-o -w"               "$GS" -o -w "foo" tests/multi.txt
+check "-o -E alternation"   "$GS" -oE "(foo|bar)+" tests/small.txt
+check "-o -F patterns"      "$GS" -oF -e "foo" -e "alpha" tests/multi.txt
+check "-o empty matches"    "$GS" -o "a*" tests/multi.txt
+check "-o back-reference"   "$GS" -o '\(o\)\1' tests/multi.txt
+
+# 13) Context lines (-A, -B, -C), also across buffer refills and with
+#     back-references, where the line is NUL-terminated for the match
+check "-A after context"    "$GS" -A 3 "foo" tests/refill.txt
+check "-B before context"   "$GS" -B 4 "foo" tests/refill.txt
+check "-C -n context"       "$GS" -n -C 2 "foo" tests/refill.txt
+check "-C multi-file"       "$GS" -C 1 "foo" tests/small.txt tests/multi.txt
+check "-A -B -n multi-file" "$GS" -A 2 -B 1 -n "foo" tests/refill.txt tests/multi.txt
+check "-m with -A"          "$GS" -m 3 -A 40 "foo" tests/refill.txt
+check "-v with -C"          "$GS" -v -C 1 "x" tests/refill.txt
+check "-B back-reference"   "$GS" -B 1 '\(o\)\1' tests/multi.txt
+check "-A back-reference"   "$GS" -A 1 '\(o\)\1' tests/multi.txt
+check "-C back-reference"   "$GS" -C 2 'f\(o\)\1' tests/refill.txt
+check "-C -n back-ref long" "$GS" -n -C 1 '\(D\)\1' tests/refill.txt
+
+# 14) Names searched with -r: --include, --exclude, --exclude-dir
+expect "-r --include" $'tests/tree/a.h:foo in a.h\ntests/tree/sub/b.h:foo in sub/b.h' \
+  "$GS" -r --include="*.h" "foo" tests/tree
+expect "-r --exclude" $'tests/tree/a.h:foo in a.h\ntests/tree/sub/b.h:foo in sub/b.h' \
+  "$GS" -r --exclude "*.c" "foo" tests/tree
+expect "-r --exclude-dir" "tests/tree/a.c:foo in a.c" \
+  "$GS" -r --exclude-dir=sub --exclude-dir=skip --include="*.c" "foo" tests/tree
+expect "--exclude of an argument" "foo in a.c" \
+  "$GS" --exclude="*.c" "foo" tests/tree/a.c
+
+# 15) Names left out with --ignore-file: "*.log" with "!keep.log" taking
+#     some back, "/top.txt" anchored to its directory, "build/" a directory;
+#     sub/.gitignore takes y.log back in
+expect "--ignore-file" $'tests/ign/a.txt:foo in a.txt
+tests/ign/keep.log:foo in keep.log
+tests/ign/sub/keep.log:foo in sub/keep.log
+tests/ign/sub/top.txt:foo in sub/top.txt
+tests/ign/sub/y.log:foo in sub/y.log' \
+  "$GS" -r --ignore-file=.gitignore "foo" tests/ign
+
+# 16) Counting lines that do not match (-c -v), also where an index
+#     would skip a file that does not contain the pattern
+check "-c -v"               "$GS" -c -v "foo" tests/small.txt tests/multi.txt tests/refill.txt
+check "-c -v -x"            "$GS" -c -v -x "exact-line" tests/edge.txt
+check "-c -v no match"      "$GS" -c -v "zzz" tests/small.txt tests/edge.txt
+check "-c -v -m"            "$GS" -c -v -m 2 "foo" tests/small.txt tests/multi.txt
+check "-c -v traditional"   "$G" -c -v "foo" tests/small.txt tests/multi.txt
+if [[ -f "${OUTDIR}/index" ]]; then
+  GREP_INDEX="${OUTDIR}/index" \
+    check "-c -v with an index" "$G" -c -v "foo" tests/small.txt tests/edge.txt \
+      tests/multi.txt
+fi
+
+# 17) Runs of lines that do not match (-v), written whole
+check "-v -n multi-file"    "$GS" -v -n "foo" tests/small.txt tests/multi.txt tests/case.txt
+check "-v -n long runs"     "$GS" -v -n "foo" tests/refill.txt
+check "-v -n -i"            "$GS" -v -n -i "foo" tests/case.txt
+check "-v -x"               "$GS" -v -n -x "exact-line" tests/edge.txt tests/refill.txt
+check "-v traditional"      "$G" -v "foo" tests/small.txt tests/multi.txt
+
+if [[ $FAILED -ne 0 ]]; then
+  echo "$FAILED smoke test(s) FAILED"
+  exit 1
+fi
 echo "All minimal smoke tests PASSED"
\ No newline at end of file
@@ -0,0 +1 @@
+foo in skip/c.c
@@ -0,0 +1 @@
+foo in sub/b.h